@@ -0,0 +1,323 @@
+#include "block_cache.h"
+#include "iss.h"
+#include "rv32m.h"
+#include "syscall.h"
+
+// handlers
+static void op_nop(BlockContext&, const BlockOp&) {}
+
+static void op_lui(BlockContext&, const BlockOp& op) { *op.rd = op.imm; }
+static void op_auipc(BlockContext&, const BlockOp& op) { *op.rd = int32_t(op.pc) + op.imm; }
+
+static void op_jal(BlockContext& ctx, const BlockOp& op)
+{
+	*op.rd = int32_t(op.pc + WORD_SIZE);
+	ctx.next_pc = op.pc + op.imm;
+}
+
+static void op_jalr(BlockContext& ctx, const BlockOp& op)
+{
+	uint32_t target = (*op.rs1 + op.imm) & 0xfffffffe; // LSB -> 0
+	*op.rd = int32_t(op.pc + WORD_SIZE);
+	ctx.next_pc = target;
+}
+
+static void branch(BlockContext& ctx, const BlockOp& op, bool cond)
+{
+	ctx.next_pc = cond ? op.pc + op.imm : op.pc + WORD_SIZE;
+}
+static void op_beq(BlockContext& ctx, const BlockOp& op) { branch(ctx, op, *op.rs1 == *op.rs2); }
+static void op_bne(BlockContext& ctx, const BlockOp& op) { branch(ctx, op, *op.rs1 != *op.rs2); }
+static void op_blt(BlockContext& ctx, const BlockOp& op) { branch(ctx, op, *op.rs1 < *op.rs2); }
+static void op_bge(BlockContext& ctx, const BlockOp& op) { branch(ctx, op, *op.rs1 >= *op.rs2); }
+static void op_bltu(BlockContext& ctx, const BlockOp& op) { branch(ctx, op, uint32_t(*op.rs1) < uint32_t(*op.rs2)); }
+static void op_bgeu(BlockContext& ctx, const BlockOp& op) { branch(ctx, op, uint32_t(*op.rs1) >= uint32_t(*op.rs2)); }
+
+static void op_lb(BlockContext& ctx, const BlockOp& op) { *op.rd = ctx.memory->read_int(*op.rs1 + op.imm, BYTE_SIZE); }
+static void op_lh(BlockContext& ctx, const BlockOp& op) { *op.rd = ctx.memory->read_int(*op.rs1 + op.imm, HALFWORD_SIZE); }
+static void op_lw(BlockContext& ctx, const BlockOp& op) { *op.rd = ctx.memory->read_int(*op.rs1 + op.imm, WORD_SIZE); }
+static void op_lbu(BlockContext& ctx, const BlockOp& op) { *op.rd = ctx.memory->read_int(*op.rs1 + op.imm, BYTE_SIZE, false); }
+static void op_lhu(BlockContext& ctx, const BlockOp& op) { *op.rd = ctx.memory->read_int(*op.rs1 + op.imm, HALFWORD_SIZE, false); }
+
+static void op_sb(BlockContext& ctx, const BlockOp& op) { ctx.memory->write(*op.rs1 + op.imm, BYTE_SIZE, (uint32_t*)op.rs2); }
+static void op_sh(BlockContext& ctx, const BlockOp& op) { ctx.memory->write(*op.rs1 + op.imm, HALFWORD_SIZE, (uint32_t*)op.rs2); }
+static void op_sw(BlockContext& ctx, const BlockOp& op) { ctx.memory->write(*op.rs1 + op.imm, WORD_SIZE, (uint32_t*)op.rs2); }
+
+static void op_addi(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 + op.imm; }
+static void op_slti(BlockContext&, const BlockOp& op) { *op.rd = int32_t(*op.rs1 < op.imm); }
+static void op_sltiu(BlockContext&, const BlockOp& op) { *op.rd = int32_t(uint32_t(*op.rs1) < uint32_t(op.imm)); }
+static void op_xori(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 ^ op.imm; }
+static void op_ori(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 | op.imm; }
+static void op_andi(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 & op.imm; }
+static void op_slli(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 << op.imm; }
+static void op_srli(BlockContext&, const BlockOp& op) { *op.rd = uint32_t(*op.rs1) >> op.imm; }
+static void op_srai(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 >> op.imm; }
+
+static void op_add(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 + *op.rs2; }
+static void op_sub(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 - *op.rs2; }
+static void op_sll(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 << (*op.rs2 & 0x1f); }
+static void op_slt(BlockContext&, const BlockOp& op) { *op.rd = int32_t(*op.rs1 < *op.rs2); }
+static void op_sltu(BlockContext&, const BlockOp& op) { *op.rd = int32_t(uint32_t(*op.rs1) < uint32_t(*op.rs2)); }
+static void op_xor(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 ^ *op.rs2; }
+static void op_srl(BlockContext&, const BlockOp& op) { *op.rd = uint32_t(*op.rs1) >> (*op.rs2 & 0x1f); }
+static void op_sra(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 >> (*op.rs2 & 0x1f); }
+static void op_or(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 | *op.rs2; }
+static void op_and(BlockContext&, const BlockOp& op) { *op.rd = *op.rs1 & *op.rs2; }
+
+static void op_mul(BlockContext&, const BlockOp& op) { *op.rd = rv32m_mul(*op.rs1, *op.rs2); }
+static void op_mulh(BlockContext&, const BlockOp& op) { *op.rd = rv32m_mulh(*op.rs1, *op.rs2); }
+static void op_mulhsu(BlockContext&, const BlockOp& op) { *op.rd = rv32m_mulhsu(*op.rs1, *op.rs2); }
+static void op_mulhu(BlockContext&, const BlockOp& op) { *op.rd = rv32m_mulhu(*op.rs1, *op.rs2); }
+static void op_div(BlockContext&, const BlockOp& op) { *op.rd = rv32m_div(*op.rs1, *op.rs2); }
+static void op_divu(BlockContext&, const BlockOp& op) { *op.rd = rv32m_divu(*op.rs1, *op.rs2); }
+static void op_rem(BlockContext&, const BlockOp& op) { *op.rd = rv32m_rem(*op.rs1, *op.rs2); }
+static void op_remu(BlockContext&, const BlockOp& op) { *op.rd = rv32m_remu(*op.rs1, *op.rs2); }
+
+static void op_amo(BlockContext& ctx, const BlockOp& op)
+{
+	uint32_t addr = *op.rs1;
+	int32_t src = *op.rs2;
+	if (op.function == Function::SC_W) {
+		ctx.memory->write(addr, WORD_SIZE, (uint32_t*)&src);
+		*op.rd = 0;
+		return;
+	}
+
+	int32_t load_value = ctx.memory->read_int(addr, WORD_SIZE);
+	int32_t result = load_value;
+	switch (op.function)
+	{
+	case Function::AMOSWAP_W: result = src; break;
+	case Function::AMOADD_W: result = load_value + src; break;
+	case Function::AMOXOR_W: result = load_value ^ src; break;
+	case Function::AMOAND_W: result = load_value & src; break;
+	case Function::AMOOR_W: result = load_value | src; break;
+	case Function::AMOMIN_W: result = (load_value < src) ? load_value : src; break;
+	case Function::AMOMAX_W: result = (load_value > src) ? load_value : src; break;
+	case Function::AMOMINU_W: result = (uint32_t(load_value) < uint32_t(src)) ? load_value : src; break;
+	case Function::AMOMAXU_W: result = (uint32_t(load_value) > uint32_t(src)) ? load_value : src; break;
+	default: break;
+	}
+	if (op.function != Function::LR_W)
+		ctx.memory->write(addr, WORD_SIZE, (uint32_t*)&result);
+	*op.rd = load_value;
+}
+
+static void op_flw(BlockContext& ctx, const BlockOp& op) { *op.fd = ctx.memory->read_float(*op.rs1 + op.imm); }
+static void op_fsw(BlockContext& ctx, const BlockOp& op) { ctx.memory->write(*op.rs1 + op.imm, WORD_SIZE, (uint32_t*)op.fs2); }
+static void op_fadd(BlockContext&, const BlockOp& op) { *op.fd = *op.fs1 + *op.fs2; }
+static void op_fsub(BlockContext&, const BlockOp& op) { *op.fd = *op.fs1 - *op.fs2; }
+static void op_fmul(BlockContext&, const BlockOp& op) { *op.fd = *op.fs1 * *op.fs2; }
+static void op_fdiv(BlockContext&, const BlockOp& op) { *op.fd = *op.fs1 / *op.fs2; }
+
+static void op_ecall(BlockContext& ctx, const BlockOp& op)
+{
+	handle_syscall(*ctx.register_file, *ctx.memory, ctx.instret);
+	ctx.next_pc = op.pc + WORD_SIZE;
+}
+
+static void op_fence_i(BlockContext& ctx, const BlockOp&)
+{
+	ctx.memory->flush_decode_cache();
+}
+
+void BlockCache::bind(const Instruction& insn, BlockOp& op)
+{
+	RegisterFile* rf = ctx.register_file;
+	const Fields& f = insn.fields;
+
+	op.pc = f.pc;
+	op.imm = int32_t(f.imm);
+	op.function = insn.function;
+	op.rd = (f.rd == 0) ? &ctx.sink : &rf->gpr[f.rd];
+	op.rs1 = &rf->gpr[f.rs1];
+	op.rs2 = &rf->gpr[f.rs2];
+	op.fd = &rf->fpr[f.rd];
+	op.fs1 = &rf->fpr[f.rs1];
+	op.fs2 = &rf->fpr[f.rs2];
+
+	switch (insn.function)
+	{
+	case Function::LUI: op.handler = op_lui; break;
+	case Function::AUIPC: op.handler = op_auipc; break;
+	case Function::JAL: op.handler = op_jal; break;
+	case Function::JALR: op.handler = op_jalr; break;
+
+	case Function::BEQ: op.handler = op_beq; break;
+	case Function::BNE: op.handler = op_bne; break;
+	case Function::BLT: op.handler = op_blt; break;
+	case Function::BGE: op.handler = op_bge; break;
+	case Function::BLTU: op.handler = op_bltu; break;
+	case Function::BGEU: op.handler = op_bgeu; break;
+
+	case Function::LB: op.handler = op_lb; break;
+	case Function::LH: op.handler = op_lh; break;
+	case Function::LW: op.handler = op_lw; break;
+	case Function::LBU: op.handler = op_lbu; break;
+	case Function::LHU: op.handler = op_lhu; break;
+
+	case Function::SB: op.handler = op_sb; break;
+	case Function::SH: op.handler = op_sh; break;
+	case Function::SW: op.handler = op_sw; break;
+
+	case Function::ADDI: op.handler = op_addi; break;
+	case Function::SLTI: op.handler = op_slti; break;
+	case Function::SLTIU: op.handler = op_sltiu; break;
+	case Function::XORI: op.handler = op_xori; break;
+	case Function::ORI: op.handler = op_ori; break;
+	case Function::ANDI: op.handler = op_andi; break;
+	case Function::SLLI: op.handler = op_slli; break;
+	case Function::SRLI: op.handler = op_srli; break;
+	case Function::SRAI: op.handler = op_srai; break;
+
+	case Function::ADD: op.handler = op_add; break;
+	case Function::SUB: op.handler = op_sub; break;
+	case Function::SLL: op.handler = op_sll; break;
+	case Function::SLT: op.handler = op_slt; break;
+	case Function::SLTU: op.handler = op_sltu; break;
+	case Function::XOR: op.handler = op_xor; break;
+	case Function::SRL: op.handler = op_srl; break;
+	case Function::SRA: op.handler = op_sra; break;
+	case Function::OR: op.handler = op_or; break;
+	case Function::AND: op.handler = op_and; break;
+
+	case Function::MUL: op.handler = op_mul; break;
+	case Function::MULH: op.handler = op_mulh; break;
+	case Function::MULHSU: op.handler = op_mulhsu; break;
+	case Function::MULHU: op.handler = op_mulhu; break;
+	case Function::DIV: op.handler = op_div; break;
+	case Function::DIVU: op.handler = op_divu; break;
+	case Function::REM: op.handler = op_rem; break;
+	case Function::REMU: op.handler = op_remu; break;
+
+	case Function::ECALL: op.handler = op_ecall; break;
+
+	case Function::LR_W:
+	case Function::SC_W:
+	case Function::AMOSWAP_W:
+	case Function::AMOADD_W:
+	case Function::AMOXOR_W:
+	case Function::AMOAND_W:
+	case Function::AMOOR_W:
+	case Function::AMOMIN_W:
+	case Function::AMOMAX_W:
+	case Function::AMOMINU_W:
+	case Function::AMOMAXU_W:
+		op.handler = op_amo;
+		break;
+
+	case Function::FLW: op.handler = op_flw; break;
+	case Function::FSW: op.handler = op_fsw; break;
+	case Function::FADD_S: op.handler = op_fadd; break;
+	case Function::FSUB_S: op.handler = op_fsub; break;
+	case Function::FMUL_S: op.handler = op_fmul; break;
+	case Function::FDIV_S: op.handler = op_fdiv; break;
+
+	case Function::FENCE_I: op.handler = op_fence_i; break;
+	default:
+		op.handler = op_nop;
+		break;
+	}
+}
+
+Block* BlockCache::translate(uint32_t pc)
+{
+	Block* b = new Block;
+	b->start = pc;
+
+	while (ctx.memory->in_text(pc) && b->ops.size() < BLOCK_MAX_INSNS) {
+		Instruction insn = ctx.memory->fetch_insn(pc);
+		BlockOp op;
+		bind(insn, op);
+		b->ops.emplace_back(op);
+		pc += WORD_SIZE;
+
+		if (insn.opcode == Opcode::BRANCH
+			|| insn.opcode == Opcode::JAL
+			|| insn.opcode == Opcode::JALR
+			|| insn.function == Function::ECALL
+			|| insn.function == Function::FENCE_I)
+			break;
+	}
+	b->end = pc;
+
+	blocks[b->start] = b;
+	return b;
+}
+
+Block* BlockCache::lookup(uint32_t pc)
+{
+	if (generation != ctx.memory->text_generation()) {
+		flush();
+		generation = ctx.memory->text_generation();
+	}
+
+	auto it = blocks.find(pc);
+	if (it != blocks.end())
+		return it->second;
+	if (!ctx.memory->in_text(pc))
+		return nullptr;
+	return translate(pc);
+}
+
+Block* BlockCache::link(Block* b, uint32_t pc)
+{
+	Block* next = lookup(pc);
+	if (next) {
+		BlockExit& e = b->exits[pc == b->end ? 0 : 1];
+		e.pc = pc;
+		e.block = next;
+	}
+	return next;
+}
+
+void BlockCache::flush()
+{
+	for (auto& it : blocks)
+		delete it.second;
+	blocks.clear();
+	jit.reset();
+}
+
+// executes whole blocks until the next one would pass the switch point
+void BlockCache::run(const SwitchPoint& point, unsigned long long& instret)
+{
+	RegisterFile* rf = ctx.register_file;
+	ctx.instret = instret;
+
+	Block* b = lookup(uint32_t(rf->pc));
+	while (b && !b->ops.empty()) {
+		if (point.use_count && ctx.instret + b->ops.size() > point.insn_count)
+			break;
+		if (point.use_pc && b->start < point.pc && point.pc < b->end)
+			break;
+
+		ctx.instret += b->ops.size();
+		if (b->code) {
+			ctx.next_pc = b->code(rf, ctx.memory);
+		}
+		else {
+			ctx.next_pc = b->end;
+			for (const BlockOp& op : b->ops)
+				op.handler(ctx, op);
+			if (++b->runs == JIT_THRESHOLD && use_jit)
+				b->code = jit.compile(*b);
+		}
+		rf->pc = ctx.next_pc;
+
+		if (point.use_pc && ctx.next_pc == point.pc)
+			break;
+
+		// a flush after a text write drops every link
+		if (generation != ctx.memory->text_generation())
+			b = lookup(ctx.next_pc);
+		else if (b->exits[0].block && b->exits[0].pc == ctx.next_pc)
+			b = b->exits[0].block;
+		else if (b->exits[1].block && b->exits[1].pc == ctx.next_pc)
+			b = b->exits[1].block;
+		else
+			b = link(b, ctx.next_pc);
+	}
+
+	instret = ctx.instret;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "instruction.h"
+#include "memory.h"
+#include "registers.h"
+#include "jit.h"
+#include <unordered_map>
+#include <vector>
+
+#define BLOCK_MAX_INSNS 64
+
+struct SwitchPoint;
+struct BlockOp;
+
+struct BlockContext {
+	RegisterFile* register_file{ nullptr };
+	Memory* memory{ nullptr };
+	unsigned long long instret{ 0 };
+	uint32_t next_pc{ 0 };
+
+	// destination for writes to x0
+	int32_t sink{ 0 };
+};
+
+typedef void (*OpHandler)(BlockContext& ctx, const BlockOp& op);
+
+// one translated instruction with its operands bound to register slots
+struct BlockOp {
+	OpHandler handler{ nullptr };
+	int32_t* rd{ nullptr };
+	const int32_t* rs1{ nullptr };
+	const int32_t* rs2{ nullptr };
+	float* fd{ nullptr };
+	const float* fs1{ nullptr };
+	const float* fs2{ nullptr };
+	int32_t imm{ 0 };
+	uint32_t pc{ 0 };
+	Function function{ Function::NOP };
+};
+
+struct BlockExit {
+	uint32_t pc{ 0 };
+	struct Block* block{ nullptr };
+};
+
+// straight-line code ending at BRANCH/JAL/JALR/ECALL
+struct Block {
+	uint32_t start{ 0 };
+	uint32_t end{ 0 };
+	std::vector<BlockOp> ops;
+
+	// chained successors: [0] falls through to end, [1] is the last
+	// other target taken
+	BlockExit exits[2];
+
+	// host code once the block turns hot
+	unsigned int runs{ 0 };
+	JitCode code{ nullptr };
+};
+
+class BlockCache {
+	BlockContext ctx;
+	std::unordered_map<uint32_t, Block*> blocks;
+	uint32_t generation{ 0 };
+
+	Jit jit;
+	// false interprets every block, see --jit
+	bool use_jit{ true };
+
+private:
+	void bind(const Instruction& insn, BlockOp& op);
+	Block* translate(uint32_t pc);
+	Block* lookup(uint32_t pc);
+	// links the exit of b taken to pc, on a chain miss
+	Block* link(Block* b, uint32_t pc);
+	void flush();
+
+public:
+	BlockCache(Memory* mem, RegisterFile* rf, bool use_jit = true) : jit(mem), use_jit(use_jit) {
+		ctx.memory = mem;
+		ctx.register_file = rf;
+	}
+	~BlockCache() { flush(); }
+
+	void run(const SwitchPoint& point, unsigned long long& instret);
+};
@@ -0,0 +1,408 @@
+#include "branch_predictor.h"
+#include <stdlib.h>
+#include <math.h>
+
+static const char* kind_name[] = { "bimodal", "gshare", "tournament", "tage" };
+
+static bool power_of_two(uint32_t v) { return v && (v & (v - 1)) == 0; }
+
+static void train(uint8_t& counter, bool taken)
+{
+	if (taken && counter < 3) ++counter;
+	if (!taken && counter > 0) --counter;
+}
+
+static void train(int8_t& counter, bool up, int8_t min, int8_t max)
+{
+	if (up && counter < max) ++counter;
+	if (!up && counter > min) --counter;
+}
+
+void BranchPredictor::report(std::ostream& os) const
+{
+	double rate = branches ? 100.0 * mispredicts / branches : 0.0;
+	double mpki = instructions ? 1000.0 * mispredicts / instructions : 0.0;
+	os << std::dec << "[ " << name << " ] branches " << branches
+		<< " mispredicts " << mispredicts << " (" << rate << "%)"
+		<< " MPKI " << mpki << std::endl;
+}
+
+CounterPredictor::CounterPredictor(const PredictorConfig& config)
+	: BranchPredictor(kind_name[int(config.kind)]), kind(config.kind)
+{
+	if (!power_of_two(config.table_size) || config.history_bits > 31) {
+		std::clog << "invalid branch predictor geometry" << std::endl;
+		exit(1);
+	}
+
+	index_mask = config.table_size - 1;
+	history_mask = (1u << config.history_bits) - 1;
+
+	// weakly taken
+	if (kind != PredictorKind::GSHARE)
+		bimodal.assign(config.table_size, 2);
+	if (kind != PredictorKind::BIMODAL)
+		gshare.assign(config.table_size, 2);
+	if (kind == PredictorKind::TOURNAMENT)
+		chooser.assign(config.table_size, 2);
+}
+
+bool CounterPredictor::predict(uint32_t pc, uint32_t& checkpoint)
+{
+	checkpoint = history;
+
+	bool taken = false;
+	switch (kind)
+	{
+	case PredictorKind::GSHARE:
+		taken = gshare[gshare_index(pc, history)] >= 2;
+		break;
+	case PredictorKind::TOURNAMENT:
+		if (chooser[bimodal_index(pc)] >= 2)
+			taken = gshare[gshare_index(pc, history)] >= 2;
+		else
+			taken = bimodal[bimodal_index(pc)] >= 2;
+		break;
+	default:
+		taken = bimodal[bimodal_index(pc)] >= 2;
+		break;
+	}
+
+	history = ((history << 1) | taken) & history_mask;
+	return taken;
+}
+
+void CounterPredictor::update(uint32_t pc, uint32_t checkpoint, bool taken, bool predicted)
+{
+	count(taken, predicted);
+
+	switch (kind)
+	{
+	case PredictorKind::GSHARE:
+		train(gshare[gshare_index(pc, checkpoint)], taken);
+		break;
+	case PredictorKind::TOURNAMENT: {
+		uint8_t& b = bimodal[bimodal_index(pc)];
+		uint8_t& g = gshare[gshare_index(pc, checkpoint)];
+		bool b_ok = (b >= 2) == taken;
+		bool g_ok = (g >= 2) == taken;
+		if (b_ok != g_ok)
+			train(chooser[bimodal_index(pc)], g_ok);
+		train(b, taken);
+		train(g, taken);
+		break;
+	}
+	default:
+		train(bimodal[bimodal_index(pc)], taken);
+		break;
+	}
+
+	committed_history = ((committed_history << 1) | taken) & history_mask;
+}
+
+TagePredictor::TagePredictor(const PredictorConfig& config)
+	: BranchPredictor("tage")
+{
+	if (!power_of_two(config.table_size) || config.history_bits < TAGE_MIN_HISTORY * 2
+		|| config.history_bits > TAGE_RING_SIZE - TAGE_CHECKPOINTS
+		|| config.in_flight > TAGE_MAX_IN_FLIGHT) {
+		std::clog << "invalid branch predictor geometry" << std::endl;
+		exit(1);
+	}
+
+	while ((1u << index_bits) < config.table_size)
+		++index_bits;
+
+	// geometric series from TAGE_MIN_HISTORY to the configured maximum
+	double ratio = double(config.history_bits) / TAGE_MIN_HISTORY;
+	for (uint32_t t = 0; t < n_tables; ++t) {
+		history_length[t] = uint32_t(TAGE_MIN_HISTORY * pow(ratio, double(t) / (n_tables - 1)) + 0.5);
+		tables[t].resize(config.table_size);
+		history.index[t] = { 0, history_length[t], index_bits ? index_bits : 1 };
+		history.tag[t] = { 0, history_length[t], TAGE_TAG_BITS };
+		history.tag2[t] = { 0, history_length[t], TAGE_TAG_BITS - 1 };
+	}
+	committed = history;
+
+	base.assign(config.table_size, 2);
+	loops.resize(LOOP_ENTRIES);
+	// a checkpoint per in-flight branch, and a ring that holds the longest
+	// history behind all of them
+	uint32_t n_checkpoints = TAGE_CHECKPOINTS;
+	while (n_checkpoints < config.in_flight)
+		n_checkpoints <<= 1;
+	uint32_t ring_size = TAGE_RING_SIZE;
+	while (ring_size < n_checkpoints + config.history_bits)
+		ring_size <<= 1;
+	ring.resize(ring_size);
+	checkpoints.resize(n_checkpoints);
+}
+
+uint32_t TagePredictor::table_index(uint32_t pc, uint32_t t) const
+{
+	uint32_t mask = (1u << index_bits) - 1;
+	return ((pc >> 2) ^ (pc >> (2 + index_bits)) ^ history.index[t].value) & mask;
+}
+
+uint16_t TagePredictor::table_tag(uint32_t pc, uint32_t t) const
+{
+	uint32_t mask = (1u << TAGE_TAG_BITS) - 1;
+	return uint16_t(((pc >> 2) ^ history.tag[t].value ^ (history.tag2[t].value << 1)) & mask);
+}
+
+void TagePredictor::push(TageHistory& h, bool taken)
+{
+	ring[h.ptr & (ring.size() - 1)] = taken;
+	for (uint32_t t = 0; t < n_tables; ++t) {
+		uint8_t out = ring[(h.ptr - history_length[t]) & (ring.size() - 1)];
+		h.index[t].push(taken, out);
+		h.tag[t].push(taken, out);
+		h.tag2[t].push(taken, out);
+	}
+	++h.ptr;
+}
+
+LoopEntry* TagePredictor::loop_lookup(uint32_t pc)
+{
+	LoopEntry& e = loops[(pc >> 2) & (LOOP_ENTRIES - 1)];
+	if (e.age == 0 || e.tag != uint16_t((pc >> 2) / LOOP_ENTRIES))
+		return nullptr;
+	return &e;
+}
+
+bool TagePredictor::predict(uint32_t pc, uint32_t& checkpoint)
+{
+	// the constructor sized the ring for every branch in flight
+	checkpoint = next_checkpoint++ & (checkpoints.size() - 1);
+	TageCheckpoint& c = checkpoints[checkpoint];
+	c.history = history;
+	c.provider = -1;
+	c.alt = -1;
+
+	// longest matching history provides, the next one is the alternate
+	for (int t = int(n_tables) - 1; t >= 0; --t) {
+		c.index[t] = table_index(pc, t);
+		c.tag[t] = table_tag(pc, t);
+		if (tables[t][c.index[t]].tag == c.tag[t]) {
+			if (c.provider < 0)
+				c.provider = int8_t(t);
+			else if (c.alt < 0)
+				c.alt = int8_t(t);
+		}
+	}
+
+	bool base_pred = base[(pc >> 2) & ((1u << index_bits) - 1)] >= 2;
+	c.alt_pred = c.alt >= 0 ? tables[c.alt][c.index[c.alt]].ctr >= 0 : base_pred;
+	if (c.provider >= 0) {
+		const TageEntry& e = tables[c.provider][c.index[c.provider]];
+		c.provider_pred = e.ctr >= 0;
+		bool fresh = e.u == 0 && (e.ctr == 0 || e.ctr == -1);
+		c.tage_pred = (fresh && use_alt > 0) ? c.alt_pred : c.provider_pred;
+	}
+	else {
+		c.provider_pred = base_pred;
+		c.tage_pred = base_pred;
+	}
+
+	LoopEntry* loop = loop_lookup(pc);
+	c.loop_hit = loop && loop->confidence == 3;
+	c.loop_pred = c.loop_hit && loop->spec_iter < loop->trip;
+
+	bool taken = (c.loop_hit && use_loop >= 0) ? c.loop_pred : c.tage_pred;
+	if (loop)
+		loop->spec_iter = taken ? loop->spec_iter + 1 : 0;
+
+	push(history, taken);
+	return taken;
+}
+
+void TagePredictor::loop_update(uint32_t pc, const TageCheckpoint& c, bool taken)
+{
+	LoopEntry* e = loop_lookup(pc);
+	if (!e) {
+		// a mispredicted exit starts tracking at iteration 0
+		if (taken || c.tage_pred == taken)
+			return;
+		LoopEntry& v = loops[(pc >> 2) & (LOOP_ENTRIES - 1)];
+		if (v.age > 0 && v.confidence != 0) {
+			--v.age;
+			return;
+		}
+		v = LoopEntry();
+		v.tag = uint16_t((pc >> 2) / LOOP_ENTRIES);
+		v.age = 31;
+		return;
+	}
+
+	if (c.loop_hit) {
+		if (c.loop_pred != taken) {
+			*e = LoopEntry();
+			return;
+		}
+		if (c.loop_pred != c.tage_pred && e->age < 255)
+			++e->age;
+	}
+
+	if (taken) {
+		if (++e->iter == 0xffff) {
+			*e = LoopEntry();
+			return;
+		}
+		if (e->iter > e->trip)
+			e->confidence = 0;
+	}
+	else {
+		if (e->iter == 0) {
+			// never taken, not a loop
+			*e = LoopEntry();
+			return;
+		}
+		if (e->iter == e->trip) {
+			if (e->confidence < 3)
+				++e->confidence;
+		}
+		else {
+			e->trip = e->iter;
+			e->confidence = 0;
+		}
+		e->iter = 0;
+	}
+}
+
+void TagePredictor::allocate(const TageCheckpoint& c, bool taken)
+{
+	uint32_t first = uint32_t(c.provider + 1);
+	// xorshift32, sometimes skips the shortest candidate
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	if ((seed & 1) && first + 1 < n_tables)
+		++first;
+
+	for (uint32_t t = first; t < n_tables; ++t) {
+		TageEntry& e = tables[t][c.index[t]];
+		if (e.u == 0) {
+			e.tag = c.tag[t];
+			e.ctr = taken ? 0 : -1;
+			return;
+		}
+	}
+	for (uint32_t t = uint32_t(c.provider + 1); t < n_tables; ++t) {
+		TageEntry& e = tables[t][c.index[t]];
+		if (e.u > 0)
+			--e.u;
+	}
+}
+
+void TagePredictor::update(uint32_t pc, uint32_t checkpoint, bool taken, bool predicted)
+{
+	count(taken, predicted);
+	const TageCheckpoint& c = checkpoints[checkpoint];
+	++committed_checkpoint;
+
+	loop_update(pc, c, taken);
+	if (c.loop_hit && c.loop_pred != c.tage_pred)
+		train(use_loop, c.loop_pred == taken, -8, 7);
+
+	if (c.tage_pred != taken && c.provider < int8_t(n_tables) - 1)
+		allocate(c, taken);
+
+	TageEntry* e = c.provider >= 0 ? &tables[c.provider][c.index[c.provider]] : nullptr;
+	// the entry may have been replaced since the prediction
+	if (e && e->tag == c.tag[c.provider]) {
+		bool fresh = e->u == 0 && (e->ctr == 0 || e->ctr == -1);
+		if (fresh && c.provider_pred != c.alt_pred)
+			train(use_alt, c.alt_pred == taken, -8, 7);
+		if (e->u == 0) {
+			if (c.alt >= 0)
+				train(tables[c.alt][c.index[c.alt]].ctr, taken, -4, 3);
+			else
+				train(base[(pc >> 2) & ((1u << index_bits) - 1)], taken);
+		}
+		train(e->ctr, taken, -4, 3);
+		if (c.provider_pred != c.alt_pred) {
+			if (c.provider_pred == taken && e->u < 3)
+				++e->u;
+			else if (c.provider_pred != taken && e->u > 0)
+				--e->u;
+		}
+	}
+	else
+		train(base[(pc >> 2) & ((1u << index_bits) - 1)], taken);
+
+	// age out the usefulness bits so stale entries can be replaced
+	if (++updates % TAGE_U_RESET == 0) {
+		for (uint32_t t = 0; t < n_tables; ++t) {
+			for (TageEntry& entry : tables[t])
+				entry.u >>= 1;
+		}
+	}
+
+	// also overwrites a mispredicted outcome in the ring
+	push(committed, taken);
+}
+
+void TagePredictor::recover()
+{
+	history = committed;
+	next_checkpoint = committed_checkpoint;
+	for (LoopEntry& e : loops)
+		e.spec_iter = e.iter;
+}
+
+void TagePredictor::rewind(uint32_t c)
+{
+	next_checkpoint -= (next_checkpoint - 1 - c) & (checkpoints.size() - 1);
+	// the loop iterations of older in-flight branches are not kept
+	for (LoopEntry& e : loops)
+		e.spec_iter = e.iter;
+}
+
+void TagePredictor::repair(uint32_t checkpoint, bool taken)
+{
+	history = checkpoints[checkpoint].history;
+	push(history, taken);
+	rewind(checkpoint);
+}
+
+uint32_t TagePredictor::checkpoint()
+{
+	uint32_t c = next_checkpoint++ & (checkpoints.size() - 1);
+	checkpoints[c].history = history;
+	return c;
+}
+
+void TagePredictor::restore(uint32_t checkpoint)
+{
+	history = checkpoints[checkpoint].history;
+	rewind(checkpoint);
+}
+
+BranchPredictor* make_predictor(const PredictorConfig& config)
+{
+	if (config.kind == PredictorKind::TAGE)
+		return new TagePredictor(config);
+	return new CounterPredictor(config);
+}
+
+TargetPredictor::TargetPredictor(uint32_t btb_entries, uint32_t ras_entries)
+	: btb(power_of_two(btb_entries) ? btb_entries : 1), ras(power_of_two(ras_entries) ? ras_entries : 1)
+{
+	if (!power_of_two(btb_entries) || !power_of_two(ras_entries)) {
+		std::clog << "invalid BTB/RAS geometry" << std::endl;
+		exit(1);
+	}
+}
+
+void TargetPredictor::report(std::ostream& os) const
+{
+	double btb_rate = btb_lookups ? 100.0 * btb_misses / btb_lookups : 0.0;
+	double ras_rate = returns ? 100.0 * return_mispredicts / returns : 0.0;
+	double ind_rate = indirects ? 100.0 * indirect_mispredicts / indirects : 0.0;
+	os << std::dec << "[ BTB ] lookups " << btb_lookups << " misses " << btb_misses
+		<< " (" << btb_rate << "%)" << std::endl;
+	os << "[ RAS ] returns " << returns << " mispredicts " << return_mispredicts
+		<< " (" << ras_rate << "%)" << std::endl;
+	os << "[ indirect ] jumps " << indirects << " mispredicts " << indirect_mispredicts
+		<< " (" << ind_rate << "%)" << std::endl;
+}
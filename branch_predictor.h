@@ -0,0 +1,265 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+#include "consts.h"
+
+enum class PredictorKind {
+	BIMODAL, GSHARE, TOURNAMENT, TAGE
+};
+
+struct PredictorConfig {
+	PredictorKind kind{ PredictorKind::BIMODAL };
+	// entries per table, power of two
+	uint32_t table_size{ BP_TABLE_SIZE };
+	// global history bits, the longest tagged history for TAGE
+	uint32_t history_bits{ BP_HISTORY_BITS };
+	// most branches between predict() and update(), sizes the TAGE
+	// checkpoints and history ring
+	uint32_t in_flight{ 0 };
+};
+
+// Conditional branch direction predictor. predict() runs at fetch and
+// hands back a checkpoint for the branch; update() runs in program order
+// when the branch commits, recover() after every pipeline flush and
+// repair()/restore() after a squash behind an older instruction.
+class BranchPredictor {
+	const char* name;
+	unsigned long long branches{ 0 };
+	unsigned long long mispredicts{ 0 };
+	unsigned long long instructions{ 0 };
+
+protected:
+	void count(bool taken, bool predicted) {
+		++branches;
+		if (taken != predicted)
+			++mispredicts;
+	}
+
+public:
+	BranchPredictor(const char* name) : name(name) {}
+	virtual ~BranchPredictor() {}
+
+	virtual bool predict(uint32_t pc, uint32_t& checkpoint) = 0;
+	virtual void update(uint32_t pc, uint32_t checkpoint, bool taken, bool predicted) = 0;
+	virtual void recover() = 0;
+	// a branch resolved before commit: history continues from its
+	// checkpoint with the actual outcome
+	virtual void repair(uint32_t checkpoint, bool taken) = 0;
+	// history checkpoint for a non-branch that may redirect fetch
+	virtual uint32_t checkpoint() = 0;
+	virtual void restore(uint32_t checkpoint) = 0;
+
+	// committed instructions, for MPKI
+	void retire(unsigned long long n) { instructions += n; }
+	void report(std::ostream& os) const;
+};
+
+// bimodal, gshare and tournament predictors built from 2-bit counter tables.
+// The checkpoint is the global history the prediction was made with.
+class CounterPredictor : public BranchPredictor {
+	PredictorKind kind;
+	uint32_t index_mask{ 0 };
+	uint32_t history_mask{ 0 };
+
+	std::vector<uint8_t> bimodal;
+	std::vector<uint8_t> gshare;
+	// >= 2 selects gshare
+	std::vector<uint8_t> chooser;
+
+	uint32_t history{ 0 };
+	uint32_t committed_history{ 0 };
+
+private:
+	uint32_t bimodal_index(uint32_t pc) const { return (pc >> 2) & index_mask; }
+	uint32_t gshare_index(uint32_t pc, uint32_t hist) const { return ((pc >> 2) ^ hist) & index_mask; }
+
+public:
+	CounterPredictor(const PredictorConfig& config);
+
+	bool predict(uint32_t pc, uint32_t& checkpoint) override;
+	void update(uint32_t pc, uint32_t checkpoint, bool taken, bool predicted) override;
+	void recover() override { history = committed_history; }
+	void repair(uint32_t checkpoint, bool taken) override {
+		history = ((checkpoint << 1) | taken) & history_mask;
+	}
+	uint32_t checkpoint() override { return history; }
+	void restore(uint32_t checkpoint) override { history = checkpoint; }
+};
+
+// global history compressed to width bits, updated one outcome at a time
+struct FoldedHistory {
+	uint32_t value{ 0 };
+	uint32_t length{ 0 };
+	uint32_t width{ 0 };
+
+	void push(uint8_t in, uint8_t out) {
+		value = (value << 1) | in;
+		value ^= uint32_t(out) << (length % width);
+		value ^= value >> width;
+		value &= (1u << width) - 1;
+	}
+};
+
+struct TageEntry {
+	uint16_t tag{ 0 };
+	// 3-bit signed counter, >= 0 predicts taken
+	int8_t ctr{ 0 };
+	uint8_t u{ 0 };
+};
+
+struct LoopEntry {
+	uint16_t tag{ 0 };
+	// taken outcomes before the exit
+	uint16_t trip{ 0 };
+	uint16_t spec_iter{ 0 };
+	uint16_t iter{ 0 };
+	uint8_t confidence{ 0 };
+	uint8_t age{ 0 };
+};
+
+// the speculative path: history ring position plus the folded histories
+struct TageHistory {
+	uint32_t ptr{ 0 };
+	FoldedHistory index[TAGE_MAX_TABLES];
+	FoldedHistory tag[TAGE_MAX_TABLES];
+	FoldedHistory tag2[TAGE_MAX_TABLES];
+};
+
+// what predict() looked up, kept until the branch commits
+struct TageCheckpoint {
+	// the history before the branch, for repair()
+	TageHistory history;
+	uint32_t index[TAGE_MAX_TABLES];
+	uint16_t tag[TAGE_MAX_TABLES];
+	int8_t provider{ -1 };
+	int8_t alt{ -1 };
+	bool provider_pred{ false };
+	bool alt_pred{ false };
+	bool tage_pred{ false };
+	bool loop_hit{ false };
+	bool loop_pred{ false };
+};
+
+// TAGE with geometric history lengths and a loop predictor. History is
+// pushed speculatively at predict(); the committed copy replaces it on
+// recover(), with the outcome of a mispredicted branch patched into the
+// history ring at update().
+class TagePredictor : public BranchPredictor {
+	uint32_t n_tables{ TAGE_MAX_TABLES };
+	uint32_t index_bits{ 0 };
+	uint32_t history_length[TAGE_MAX_TABLES];
+
+	std::vector<uint8_t> base;
+	std::vector<TageEntry> tables[TAGE_MAX_TABLES];
+	std::vector<LoopEntry> loops;
+
+	// one byte per outcome, indexed by TageHistory::ptr
+	std::vector<uint8_t> ring;
+	TageHistory history;
+	TageHistory committed;
+
+	// in-flight branches, indexed by checkpoint
+	std::vector<TageCheckpoint> checkpoints;
+	uint32_t next_checkpoint{ 0 };
+	uint32_t committed_checkpoint{ 0 };
+
+	// > 0 prefers the alternate prediction of a newly allocated entry
+	int8_t use_alt{ 0 };
+	// >= 0 lets a confident loop entry override TAGE
+	int8_t use_loop{ 0 };
+	uint32_t updates{ 0 };
+	uint32_t seed{ 0x2545f491 };
+
+private:
+	uint32_t table_index(uint32_t pc, uint32_t t) const;
+	uint16_t table_tag(uint32_t pc, uint32_t t) const;
+	void push(TageHistory& h, bool taken);
+	// drops the checkpoints allocated after c
+	void rewind(uint32_t c);
+
+	LoopEntry* loop_lookup(uint32_t pc);
+	void loop_update(uint32_t pc, const TageCheckpoint& c, bool taken);
+	void allocate(const TageCheckpoint& c, bool taken);
+
+public:
+	TagePredictor(const PredictorConfig& config);
+
+	bool predict(uint32_t pc, uint32_t& checkpoint) override;
+	void update(uint32_t pc, uint32_t checkpoint, bool taken, bool predicted) override;
+	void recover() override;
+	void repair(uint32_t checkpoint, bool taken) override;
+	uint32_t checkpoint() override;
+	void restore(uint32_t checkpoint) override;
+};
+
+BranchPredictor* make_predictor(const PredictorConfig& config);
+
+struct BtbEntry {
+	bool valid{ false };
+	uint32_t pc{ 0 };
+	uint32_t target{ 0 };
+};
+
+// direct-mapped branch target buffer, filled at commit
+class Btb {
+	std::vector<BtbEntry> entries;
+
+public:
+	Btb(uint32_t n_entries) : entries(n_entries) {}
+
+	bool lookup(uint32_t pc, uint32_t& target) const {
+		const BtbEntry& e = entries[(pc >> 2) & (entries.size() - 1)];
+		if (!e.valid || e.pc != pc)
+			return false;
+		target = e.target;
+		return true;
+	}
+	void update(uint32_t pc, uint32_t target) {
+		BtbEntry& e = entries[(pc >> 2) & (entries.size() - 1)];
+		e.valid = true;
+		e.pc = pc;
+		e.target = target;
+	}
+};
+
+// circular return address stack; overflow overwrites the oldest entry.
+// A checkpoint is the top index plus the entry it points to.
+class ReturnStack {
+	std::vector<uint32_t> stack;
+	uint32_t top{ 0 };
+
+public:
+	ReturnStack(uint32_t n_entries) : stack(n_entries) {}
+
+	void push(uint32_t addr) { stack[++top & (stack.size() - 1)] = addr; }
+	uint32_t pop() { return stack[top-- & (stack.size() - 1)]; }
+	uint32_t peek() const { return stack[top & (stack.size() - 1)]; }
+
+	void checkpoint(uint32_t& t, uint32_t& value) const {
+		t = top;
+		value = stack[top & (stack.size() - 1)];
+	}
+	void restore(uint32_t t, uint32_t value) {
+		top = t;
+		stack[top & (stack.size() - 1)] = value;
+	}
+};
+
+// jump target prediction for the out-of-order front end
+class TargetPredictor {
+public:
+	Btb btb;
+	ReturnStack ras;
+
+	unsigned long long btb_lookups{ 0 };
+	unsigned long long btb_misses{ 0 };
+	unsigned long long returns{ 0 };
+	unsigned long long return_mispredicts{ 0 };
+	unsigned long long indirects{ 0 };
+	unsigned long long indirect_mispredicts{ 0 };
+
+	TargetPredictor(uint32_t btb_entries, uint32_t ras_entries);
+
+	void report(std::ostream& os) const;
+};
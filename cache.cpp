@@ -0,0 +1,259 @@
+#include "cache.h"
+
+static bool power_of_two(uint32_t v) { return v && (v & (v - 1)) == 0; }
+
+Cache::Cache(const char* name, const CacheConfig& config, Cache* next, uint32_t memory_latency)
+	: name(name), config(config), next(next), memory_latency(memory_latency)
+{
+	if (!power_of_two(config.line_size) || config.assoc == 0
+		|| config.size % (config.line_size * config.assoc) != 0
+		|| !power_of_two(config.size / (config.line_size * config.assoc))) {
+		std::clog << "invalid " << name << " geometry" << std::endl;
+		exit(1);
+	}
+
+	sets = config.size / (config.line_size * config.assoc);
+	while ((1u << offset_bits) < config.line_size)
+		++offset_bits;
+	lines.resize(sets * config.assoc);
+}
+
+CacheLine& Cache::victim(CacheLine* set)
+{
+	for (uint32_t i = 0; i < config.assoc; ++i) {
+		if (!set[i].valid)
+			return set[i];
+	}
+
+	if (config.policy == Replacement::RANDOM) {
+		// xorshift32
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return set[seed % config.assoc];
+	}
+
+	// LRU and FIFO differ only in when the stamp is refreshed
+	CacheLine* oldest = set;
+	for (uint32_t i = 1; i < config.assoc; ++i) {
+		if (set[i].stamp < oldest->stamp)
+			oldest = &set[i];
+	}
+	return *oldest;
+}
+
+uint32_t Cache::access(uint32_t addr, bool write, uint8_t* prefetch_source)
+{
+	++accesses;
+	uint32_t tag = addr >> offset_bits;
+	CacheLine* set = &lines[(tag & (sets - 1)) * config.assoc];
+
+	for (uint32_t i = 0; i < config.assoc; ++i) {
+		if (set[i].valid && set[i].tag == tag) {
+			if (config.policy == Replacement::LRU)
+				set[i].stamp = ++tick;
+			if (write)
+				set[i].dirty = true;
+			// first demand use of a prefetched line
+			if (prefetch_source)
+				*prefetch_source = set[i].prefetched;
+			set[i].prefetched = 0;
+			return config.hit_latency;
+		}
+	}
+
+	++misses;
+	return fill(set, addr, write, 0);
+}
+
+uint32_t Cache::prefetch(uint32_t addr, uint8_t source)
+{
+	uint32_t tag = addr >> offset_bits;
+	CacheLine* set = &lines[(tag & (sets - 1)) * config.assoc];
+	for (uint32_t i = 0; i < config.assoc; ++i) {
+		if (set[i].valid && set[i].tag == tag)
+			return 0;
+	}
+	return fill(set, addr, false, source);
+}
+
+uint32_t Cache::fill(CacheLine* set, uint32_t addr, bool write, uint8_t source)
+{
+	uint32_t latency = config.hit_latency
+		+ (next ? next->access(addr, false) : memory_latency);
+
+	CacheLine& line = victim(set);
+	if (line.valid && line.dirty) {
+		// drained through a write buffer, off the critical path
+		++writebacks;
+		if (next)
+			next->access(line.tag << offset_bits, true);
+	}
+	if (line.valid && line.prefetched)
+		++unused_prefetches[line.prefetched];
+	line.valid = true;
+	line.dirty = write;
+	line.prefetched = source;
+	line.tag = addr >> offset_bits;
+	line.stamp = ++tick;
+
+	return latency;
+}
+
+bool Cache::contains(uint32_t addr) const
+{
+	uint32_t tag = addr >> offset_bits;
+	const CacheLine* set = &lines[(tag & (sets - 1)) * config.assoc];
+	for (uint32_t i = 0; i < config.assoc; ++i) {
+		if (set[i].valid && set[i].tag == tag)
+			return true;
+	}
+	return false;
+}
+
+void Cache::report(std::ostream& os) const
+{
+	double rate = accesses ? 100.0 * misses / accesses : 0.0;
+	os << std::dec << "[ " << name << " ] accesses " << accesses
+		<< " misses " << misses << " (" << rate << "%)"
+		<< " writebacks " << writebacks << std::endl;
+}
+
+MSHR* CacheHierarchy::free_mshr()
+{
+	for (MSHR& m : mshrs) {
+		if (!m.valid || m.ready <= cycle)
+			return &m;
+	}
+	return nullptr;
+}
+
+void CacheHierarchy::credit(uint8_t source, bool late)
+{
+	if (source == 0)
+		return;
+	if (late)
+		++prefetch_stats[source - 1].late;
+	else
+		++prefetch_stats[source - 1].timely;
+}
+
+bool CacheHierarchy::load(uint32_t addr, uint32_t& latency)
+{
+	uint32_t line = l1d.line_of(addr);
+	uint8_t source = 0;
+
+	// secondary miss, wait for the fill already in flight
+	for (MSHR& m : mshrs) {
+		if (m.valid && m.line == line && m.ready > cycle) {
+			++mshr_merges;
+			l1d.access(addr, false, &source);
+			credit(source, true);
+			latency = uint32_t(m.ready - cycle);
+			return true;
+		}
+	}
+
+	if (l1d.contains(addr)) {
+		latency = l1d.access(addr, false, &source);
+		credit(source, false);
+		return true;
+	}
+
+	MSHR* m = free_mshr();
+	if (!m) {
+		++mshr_full;
+		return false;
+	}
+	latency = l1d.access(addr, false);
+	m->valid = true;
+	m->line = line;
+	m->ready = cycle + latency;
+	return true;
+}
+
+uint32_t CacheHierarchy::store(uint32_t addr)
+{
+	uint8_t source = 0;
+	uint32_t latency = l1d.access(addr, true, &source);
+	credit(source, false);
+	return latency;
+}
+
+void CacheHierarchy::prefetch(uint32_t addr, uint8_t source)
+{
+	uint32_t line = l1d.line_of(addr);
+	if (l1d.contains(addr))
+		return;
+	for (MSHR& m : mshrs) {
+		if (m.valid && m.line == line && m.ready > cycle)
+			return;
+	}
+
+	MSHR* m = free_mshr();
+	if (!m) {
+		++prefetch_stats[source - 1].dropped;
+		return;
+	}
+	++prefetch_stats[source - 1].issued;
+	m->valid = true;
+	m->line = line;
+	m->ready = cycle + l1d.prefetch(addr, source);
+}
+
+bool CacheHierarchy::add_prefetcher(Prefetcher* p)
+{
+	if (prefetchers.size() >= MAX_PREFETCHERS)
+		return false;
+	prefetchers.emplace_back(p);
+	prefetch_stats.emplace_back();
+	return true;
+}
+
+void CacheHierarchy::train(uint32_t pc, uint32_t addr)
+{
+	if (prefetchers.empty())
+		return;
+
+	bool miss = !l1d.contains(addr);
+	for (size_t i = 0; i < prefetchers.size(); ++i) {
+		candidates.clear();
+		prefetchers[i]->train(pc, addr, miss, candidates);
+		for (uint32_t c : candidates)
+			prefetch(c, uint8_t(i + 1));
+	}
+}
+
+void CacheHierarchy::report(std::ostream& os) const
+{
+	l1i.report(os);
+	l1d.report(os);
+	l2.report(os);
+	os << std::dec << "[ MSHR ] " << mshrs.size() << " entries, merges " << mshr_merges
+		<< " stalls " << mshr_full << std::endl;
+
+	// accuracy: used / issued, coverage: used / (used + remaining demand misses)
+	for (size_t i = 0; i < prefetchers.size(); ++i) {
+		const PrefetchStats& st = prefetch_stats[i];
+		unsigned long long used = st.timely + st.late;
+		double accuracy = st.issued ? 100.0 * used / st.issued : 0.0;
+		double coverage = (used + l1d.get_misses()) ? 100.0 * used / (used + l1d.get_misses()) : 0.0;
+		os << "[ prefetch " << prefetchers[i]->name() << " ] issued " << st.issued
+			<< " dropped " << st.dropped << " timely " << st.timely << " late " << st.late
+			<< " unused " << l1d.get_unused_prefetches(uint8_t(i + 1))
+			<< " accuracy " << accuracy << "% coverage " << coverage << "%" << std::endl;
+	}
+}
+
+bool FetchPort::ready(CacheHierarchy* caches, uint32_t fetch_pc)
+{
+	if (!busy || pc != fetch_pc) {
+		busy = true;
+		pc = fetch_pc;
+		cycle = 0;
+		latency = caches->fetch(fetch_pc);
+	}
+	if (cycle < latency)
+		++cycle;
+	return cycle >= latency;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <stdint.h>
+#include "consts.h"
+#include "prefetch.h"
+#include <vector>
+#include <iostream>
+
+enum class Replacement {
+	LRU, FIFO, RANDOM
+};
+
+struct CacheConfig {
+	uint32_t size{ 0 };
+	uint32_t assoc{ 1 };
+	uint32_t line_size{ LINE_SIZE };
+	Replacement policy{ Replacement::LRU };
+	uint32_t hit_latency{ 1 };
+};
+
+struct CacheLine {
+	bool valid{ false };
+	bool dirty{ false };
+	// prefetcher that brought the line in and it has not been used yet
+	uint8_t prefetched{ 0 };
+	uint32_t tag{ 0 };
+	// last use (LRU) or fill time (FIFO)
+	unsigned long long stamp{ 0 };
+};
+
+// set-associative, write-back / write-allocate
+class Cache {
+	const char* name;
+	CacheConfig config;
+	uint32_t sets{ 0 };
+	uint32_t offset_bits{ 0 };
+	std::vector<CacheLine> lines;
+
+	// next level, main memory when nullptr
+	Cache* next{ nullptr };
+	uint32_t memory_latency{ 0 };
+
+	unsigned long long tick{ 0 };
+	uint32_t seed{ 0x2545f491 };
+
+	unsigned long long accesses{ 0 };
+	unsigned long long misses{ 0 };
+	unsigned long long writebacks{ 0 };
+	unsigned long long unused_prefetches[MAX_PREFETCHERS + 1]{ 0 };
+
+private:
+	CacheLine& victim(CacheLine* set);
+	uint32_t fill(CacheLine* set, uint32_t addr, bool write, uint8_t source);
+
+public:
+	Cache(const char* name, const CacheConfig& config, Cache* next, uint32_t memory_latency);
+
+	// returns the access latency in cycles
+	uint32_t access(uint32_t addr, bool write, uint8_t* prefetch_source = nullptr);
+	// 0 when the line is already present
+	uint32_t prefetch(uint32_t addr, uint8_t source);
+	unsigned long long get_unused_prefetches(uint8_t source) const { return unused_prefetches[source]; }
+	bool contains(uint32_t addr) const;
+	uint32_t line_of(uint32_t addr) const { return addr >> offset_bits; }
+	uint32_t get_line_size() const { return config.line_size; }
+	unsigned long long get_misses() const { return misses; }
+	void report(std::ostream& os) const;
+};
+
+// miss status holding register, one outstanding L1D line fill
+struct MSHR {
+	bool valid{ false };
+	uint32_t line{ 0 };
+	unsigned long long ready{ 0 };
+};
+
+struct PrefetchStats {
+	unsigned long long issued{ 0 };
+	// no free MSHR
+	unsigned long long dropped{ 0 };
+	// demand use after / before the fill completed
+	unsigned long long timely{ 0 };
+	unsigned long long late{ 0 };
+};
+
+class CacheHierarchy {
+	Cache l2;
+	Cache l1i;
+	Cache l1d;
+
+	std::vector<MSHR> mshrs;
+	unsigned long long cycle{ 0 };
+
+	unsigned long long mshr_merges{ 0 };
+	unsigned long long mshr_full{ 0 };
+
+	// prefetcher i fills lines tagged with source i + 1
+	std::vector<Prefetcher*> prefetchers;
+	std::vector<PrefetchStats> prefetch_stats;
+	std::vector<uint32_t> candidates;
+
+private:
+	MSHR* free_mshr();
+	void credit(uint8_t source, bool late);
+	void prefetch(uint32_t addr, uint8_t source);
+
+public:
+	CacheHierarchy(const CacheConfig& l1i_config, const CacheConfig& l1d_config
+		, const CacheConfig& l2_config, uint32_t memory_latency, uint32_t n_mshrs)
+		: l2("L2", l2_config, nullptr, memory_latency)
+		, l1i("L1I", l1i_config, &l2, 0)
+		, l1d("L1D", l1d_config, &l2, 0)
+		, mshrs(n_mshrs) {}
+	~CacheHierarchy() {
+		for (Prefetcher* p : prefetchers)
+			delete p;
+	}
+
+	// false when MAX_PREFETCHERS are already attached
+	bool add_prefetcher(Prefetcher* p);
+	uint32_t line_size() const { return l1d.get_line_size(); }
+
+	// advances the clock that outstanding misses complete against
+	void tick() { ++cycle; }
+
+	uint32_t fetch(uint32_t pc) { return l1i.access(pc, false); }
+	// false when the load misses and every MSHR is busy
+	bool load(uint32_t addr, uint32_t& latency);
+	uint32_t store(uint32_t addr);
+	// feeds a demand address to the prefetchers
+	void train(uint32_t pc, uint32_t addr);
+
+	void report(std::ostream& os) const;
+};
+
+// one outstanding instruction fetch through L1I
+class FetchPort {
+	bool busy{ false };
+	uint32_t pc{ 0 };
+	uint32_t cycle{ 0 };
+	uint32_t latency{ 0 };
+
+public:
+	// called once per fetch attempt, true once the line for fetch_pc has arrived
+	bool ready(CacheHierarchy* caches, uint32_t fetch_pc);
+	void consume() { busy = false; }
+};
@@ -24,15 +24,104 @@
 #define FP_ADD_CYCLE 5
 #define FP_MUL_CYCLE 10
 #define FP_DIV_CYCLE 20
-#define CACHE_ACCESS_CYCLE 10
 #define MUL_CYCLE 4
 #define DIV_CYCLE 8
+// trap entry and return of an in-order ECALL, see --syscall
+#define SYSCALL_CYCLE 10
 
+// in-order bypass paths and result units, see --forward
+#define BYPASS_PATHS 3
+#define RESULT_UNITS 5
+
+// out-of-order window
+#define ROB_SIZE 64
+#define INSN_QUEUE_SIZE 16
+// reservation stations, see --rs
+#define ALU_RS_SIZE 16
+#define MULDIV_RS_SIZE 8
+#define ADDR_RS_SIZE 16
+#define LOAD_BUFFER_SIZE 16
+#define MAX_RS_ENTRIES 64
+#define STORE_QUEUE_SIZE 32
+#define FP_RS_SIZE 16
+// functional units per class, see --fu
+#define ALU_UNITS 2
+#define MULDIV_UNITS 2
+#define ADDR_UNITS 2
+#define MEM_PORTS 2
+#define FP_UNITS 2
+// out-of-order core widths, see --width
+#define ISSUE_WIDTH 2
+#define DISPATCH_WIDTH 8
+#define CDB_WIDTH 4
+#define COMMIT_WIDTH 4
+// f0-f31 follow x0-x31 in the register status and the rename map
+#define FP_REG_BASE 32
+#define LOGICAL_REGS 64
+// RAT checkpoints of the physical register file, see --prf
+#define RENAME_CHECKPOINTS 16
+// store set memory dependence predictor, see --ssit
+#define SSIT_SIZE 1024
+#define LFST_SIZE 128
+// loads looked up between clears of the store set ID table
+#define STORE_SET_RESET (1 << 20)
+// out-of-order front end, see --fetch
+#define FETCH_WIDTH 2
+#define FETCH_BLOCK_SIZE 16
+#define FTQ_SIZE 8
+
+// default cache hierarchy, see --l1i, --l1d, --l2, --mem and --mshr
+#define LINE_SIZE 64
+#define L1I_SIZE 32768
+#define L1I_ASSOC 8
+#define L1I_HIT_CYCLE 1
+#define L1D_SIZE 32768
+#define L1D_ASSOC 8
+#define L1D_HIT_CYCLE 2
+#define L2_SIZE 262144
+#define L2_ASSOC 8
+#define L2_HIT_CYCLE 10
+#define MEMORY_CYCLE 100
+#define L1D_MSHRS 8
+
+// prefetchers, see --prefetch
+#define MAX_PREFETCHERS 3
+#define PREFETCH_DEGREE 2
+#define STRIDE_TABLE_SIZE 64
+#define STREAM_BUFFERS 4
+#define STREAM_DEPTH 4
+
+// branch predictor tables, see --bp
+#define BP_TABLE_SIZE 4096
+#define BP_HISTORY_BITS 12
+#define TAGE_MAX_TABLES 8
+#define TAGE_MIN_HISTORY 4
+#define TAGE_MAX_HISTORY 160
+#define TAGE_TAG_BITS 10
+// outcome ring and in-flight branch checkpoints
+#define TAGE_RING_SIZE 2048
+#define TAGE_CHECKPOINTS 1024
+// --rob and --fetch bound the branches in flight to this
+#define TAGE_MAX_IN_FLIGHT (1u << 20)
+#define TAGE_U_RESET 262144
+#define LOOP_ENTRIES 64
+// jump targets, see --btb and --ras
+#define BTB_ENTRIES 512
+#define RAS_ENTRIES 16
+// fetch cycles lost redirecting a jump that missed the BTB
+#define BTB_MISS_PENALTY 1
+
+// default guest stack and heap sizes, see --stack and --heap
 #define STACK_SIZE 8388608
-#define STACK_OFFSET (0x0 - 8388608)
 #define REMAIN_SIZE 8388608
 #define TLS_SIZE 0xffff
 
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define PAGE_MASK (PAGE_SIZE - 1)
+#define PAGE_COUNT (1 << (32 - PAGE_SHIFT))
+#define TLB_ENTRIES 8
+
 
 enum class Stage_Result {
 	IF, 
@@ -45,9 +134,11 @@ enum class Stage_Result {
 	FPDIV, FPMUL, FPADD,
 	MULDIV, EX,
 	MEM, WB,
-    ISSUE, ADDR, CDB, COMMIT
+    ISSUE, ADDR, CDB, COMMIT,
+	ICACHE_STALL
 };
 
+// result paths of the in-order pipeline, RESULT_UNITS of them
 enum class UNIT {
 	ALU, MULDIV, FADD, FMUL, FDIV
 };
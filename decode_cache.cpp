@@ -0,0 +1,53 @@
+#include "decode_cache.h"
+#include "memory.h"
+#include <stddef.h>
+#include <algorithm>
+
+DecodeCache::DecodeCache(Memory* mem, uint32_t text_base, uint32_t text_end)
+	: memory(mem), base(text_base & ~(WORD_SIZE - 1)), end(text_end)
+{
+	if (end < base)
+		end = base;
+	size_t n = (end - base + WORD_SIZE - 1) / WORD_SIZE;
+	insns.assign(n, Instruction{ 0 });
+	valid.assign(n, false);
+}
+
+void DecodeCache::decode(uint32_t pc, Instruction& insn)
+{
+	insn = Instruction{ uint32_t(memory->read_int(pc, WORD_SIZE)) };
+	insn.fields.pc = pc;
+	insn.decode();
+}
+
+const Instruction& DecodeCache::lookup(uint32_t pc)
+{
+	if (!covers(pc) || (pc & (WORD_SIZE - 1))) {
+		decode(pc, scratch);
+		return scratch;
+	}
+
+	size_t idx = (pc - base) / WORD_SIZE;
+	if (!valid[idx]) {
+		decode(pc, insns[idx]);
+		valid[idx] = true;
+	}
+	return insns[idx];
+}
+
+// a store to text drops every word it touches
+void DecodeCache::invalidate(uint32_t vaddr, uint32_t size)
+{
+	uint64_t first = std::max(vaddr & ~uint32_t(WORD_SIZE - 1), base);
+	uint64_t stop = std::min(uint64_t(vaddr) + size, uint64_t(end));
+	for (uint64_t a = first; a < stop; a += WORD_SIZE)
+		valid[(a - base) / WORD_SIZE] = false;
+	if (first < stop)
+		++generation;
+}
+
+void DecodeCache::flush()
+{
+	valid.assign(valid.size(), false);
+	++generation;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "instruction.h"
+#include <vector>
+
+class Memory;
+
+// Predecoded instructions indexed by PC over the text segment
+class DecodeCache {
+	Memory* memory{ nullptr };
+	uint32_t base{ 0 };
+	uint32_t end{ 0 };
+
+	std::vector<Instruction> insns;
+	std::vector<bool> valid;
+
+	// pc outside of the text segment
+	Instruction scratch{ 0 };
+
+	// bumped whenever cached text may have changed
+	uint32_t generation{ 0 };
+
+private:
+	void decode(uint32_t pc, Instruction& insn);
+
+public:
+	DecodeCache(Memory* mem, uint32_t text_base, uint32_t text_end);
+
+	bool covers(uint32_t vaddr) const {
+		return base <= vaddr && vaddr < end;
+	}
+
+	uint32_t get_generation() const { return generation; }
+
+	const Instruction& lookup(uint32_t pc);
+	void invalidate(uint32_t vaddr, uint32_t size);
+	void flush();
+};
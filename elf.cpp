@@ -1,10 +1,14 @@
 #include "elf.h"
 #include "consts.h"
+#include "memory.h"
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <string.h>
 #include <memory.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 
 using namespace std;
@@ -14,9 +18,35 @@ struct Aux {
 	uint32_t value;
 };
 
+// pages wholly backed by the file are mapped copy-on-write,
+// the partial pages at either end are copied
+static void load_segment(int fd, const Elf32_Phdr& ph, char* image, uint32_t base)
+{
+	uint32_t start = ph.p_vaddr;
+	uint32_t end = ph.p_vaddr + ph.p_filesz;
+	uint32_t first = (start + PAGE_MASK) & ~uint32_t(PAGE_MASK);
+	uint32_t last = end & ~uint32_t(PAGE_MASK);
+
+	bool aligned = ((ph.p_offset - ph.p_vaddr) & PAGE_MASK) == 0;
+	if (!aligned || first >= last) {
+		pread(fd, &image[start - base], ph.p_filesz, ph.p_offset);
+		return;
+	}
+
+	void* p = mmap(&image[first - base], last - first, PROT_READ | PROT_WRITE
+		, MAP_PRIVATE | MAP_FIXED, fd, ph.p_offset + (first - start));
+	if (p == MAP_FAILED) {
+		pread(fd, &image[start - base], ph.p_filesz, ph.p_offset);
+		return;
+	}
+	pread(fd, &image[start - base], first - start, ph.p_offset);
+	pread(fd, &image[last - base], end - last, ph.p_offset + (last - start));
+}
+
 void load_elf(const char* fn
 	, uint32_t &entry_point, uint32_t &base_vaddr, uint32_t& max_addr, char* &memory
-	, char* &stack, uint32_t &sp)
+	, char* &stack, uint32_t &sp, uint32_t& text_base, uint32_t& text_end
+	, uint32_t heap_size, uint32_t stack_size)
 {
 	ifstream in{ fn, ios::binary };
 
@@ -31,8 +61,10 @@ void load_elf(const char* fn
 	}
 
 	vector<Elf32_Phdr> phdr;
-	uintptr_t max_vaddr = 0;
-	uintptr_t min_vaddr = 0xffffffff;
+	uint32_t max_vaddr = 0;
+	uint32_t min_vaddr = 0xffffffff;
+	text_base = 0xffffffff;
+	text_end = 0;
 	for (int i = 0; i < fh.e_phnum; ++i) {
 		Elf32_Phdr ph;
 		in.read((char*)(&ph), sizeof(Elf32_Phdr));
@@ -42,18 +74,31 @@ void load_elf(const char* fn
 				max_vaddr = ph.p_vaddr + ph.p_memsz;
 			if (ph.p_vaddr < min_vaddr)
 				min_vaddr = ph.p_vaddr;
+			if (ph.p_flags & PF_X) {
+				if (ph.p_vaddr < text_base)
+					text_base = ph.p_vaddr;
+				if (ph.p_vaddr + ph.p_memsz > text_end)
+					text_end = ph.p_vaddr + ph.p_memsz;
+			}
 		}
 	}
 
-	memory = new char[max_vaddr - min_vaddr + REMAIN_SIZE]();
-	
-	for (auto& ph : phdr) {
-		in.seekg(ph.p_offset, ios::beg);
-		in.read(&memory[ph.p_vaddr - min_vaddr], ph.p_filesz);
+	// whole host pages so the image can be mapped page by page
+	min_vaddr &= ~uint32_t(PAGE_MASK);
+	size_t image_size = (max_vaddr - min_vaddr + heap_size + PAGE_MASK) & ~size_t(PAGE_MASK);
+	if (min_vaddr + image_size > uint32_t(0 - stack_size)) {
+		clog << "heap overlaps the stack" << endl;
+		return;
 	}
+	memory = reserve_pages(image_size);
+
+	int fd = open(fn, O_RDONLY);
+	for (auto& ph : phdr)
+		load_segment(fd, ph, memory, min_vaddr);
+	close(fd);
 	
 	base_vaddr = min_vaddr;
-	max_addr = max_vaddr + REMAIN_SIZE;
+	max_addr = min_vaddr + image_size - 1;
 	entry_point = fh.e_entry;
 
 	uint32_t phdrs[128] = {};
@@ -63,26 +108,29 @@ void load_elf(const char* fn
 	in.read((char*)phdrs, phdr_cp_size);
 
 	sp = 0x0;
-	stack = new char[STACK_SIZE + 1] {};
+	stack = reserve_pages(stack_size);
+	uint32_t stack_base = 0 - stack_size;
 
-	size_t stack_top = sp - phdr_cp_size;
-	memcpy(&(stack[stack_top - STACK_OFFSET]), phdrs, phdr_cp_size);
-	size_t sp_phdr = stack_top;
+	// the initial stack holds 32-bit guest words whatever the host is
+	uint32_t stack_top = sp - phdr_cp_size;
+	memcpy(&(stack[uint32_t(stack_top - stack_base)]), phdrs, phdr_cp_size);
+	uint32_t sp_phdr = stack_top;
 
 	size_t len = strlen(fn) + 1;
 	stack_top -= len;
-	memcpy(&(stack[stack_top - STACK_OFFSET]), fn, len);
-	size_t argc = 1;
-	size_t argv_ptr = stack_top;
+	memcpy(&(stack[uint32_t(stack_top - stack_base)]), fn, len);
+	uint32_t argc = 1;
+	uint32_t argv_ptr = stack_top;
 
 	const char* envp[] = {""};
+	uint32_t envp_ptr[] = {0};
 	size_t envc = sizeof(envp) / sizeof(envp[0]);
 	envc = 0;		// no env
 	for (unsigned int i = 0; i < envc; ++i) {
 		len = strlen(envp[i]) + 1;
 		stack_top -= len;
-		memcpy(&(stack[stack_top - STACK_OFFSET]), envp[i], len);
-		envp[i] = (char*)(stack_top);
+		memcpy(&(stack[uint32_t(stack_top - stack_base)]), envp[i], len);
+		envp_ptr[i] = stack_top;
 	}
 
 	stack_top &= -4;
@@ -99,30 +147,69 @@ void load_elf(const char* fn
 	};
 
 	size_t naux = sizeof(aux) / sizeof(aux[0]);
-	stack_top -= (1 + argc + 1 + envc + 1 + 2 * naux) * sizeof(uintptr_t);
+	stack_top -= (1 + argc + 1 + envc + 1 + 2 * naux) * WORD_SIZE;
 	stack_top &= -16;
 	uint32_t st = stack_top;
-	memcpy(&(stack[st - STACK_OFFSET]), &argc, sizeof(uintptr_t));
-	st += sizeof(uintptr_t);
-	memcpy(&(stack[st - STACK_OFFSET]), &argv_ptr, sizeof(uintptr_t));
-	st += sizeof(uintptr_t);
+	memcpy(&(stack[st - stack_base]), &argc, WORD_SIZE);
+	st += WORD_SIZE;
+	memcpy(&(stack[st - stack_base]), &argv_ptr, WORD_SIZE);
+	st += WORD_SIZE;
 	int zero = 0;
-	memcpy(&(stack[st - STACK_OFFSET]), &zero, sizeof(uintptr_t));
-	st += sizeof(uintptr_t);
+	memcpy(&(stack[st - stack_base]), &zero, WORD_SIZE);
+	st += WORD_SIZE;
 	for (unsigned int i = 0; i < envc; ++i) {
-		memcpy(&(stack[st - STACK_OFFSET]), &envp[i], sizeof(uintptr_t));
-		st += sizeof(uintptr_t);
+		memcpy(&(stack[st - stack_base]), &envp_ptr[i], WORD_SIZE);
+		st += WORD_SIZE;
 	}
-	memcpy(&(stack[st - STACK_OFFSET]), &zero, sizeof(uintptr_t));
-	st += sizeof(uintptr_t);
+	memcpy(&(stack[st - stack_base]), &zero, WORD_SIZE);
+	st += WORD_SIZE;
 
 	for (unsigned int i = 0; i < naux; ++i) {
-		memcpy(&(stack[st - STACK_OFFSET]), &(aux[i].key), sizeof(uintptr_t));
-		st += sizeof(uintptr_t);
-		memcpy(&(stack[st - STACK_OFFSET]), &(aux[i].value), sizeof(uintptr_t));
-		st += sizeof(uintptr_t);
+		memcpy(&(stack[st - stack_base]), &(aux[i].key), WORD_SIZE);
+		st += WORD_SIZE;
+		memcpy(&(stack[st - stack_base]), &(aux[i].value), WORD_SIZE);
+		st += WORD_SIZE;
 	}
 
 	sp = stack_top;
 }
 
+
+bool find_symbol(const char* fn, const char* name, uint32_t& addr)
+{
+	ifstream in{ fn, ios::binary };
+	if (!in.is_open()) 
+		return false;
+
+	Elf32_Fhdr fh;
+	in.read((char*)(&fh), sizeof(Elf32_Fhdr));
+
+	vector<Elf32_Shdr> shdr(fh.e_shnum);
+	in.seekg(fh.e_shoff, ios::beg);
+	for (auto& sh : shdr)
+		in.read((char*)(&sh), sizeof(Elf32_Shdr));
+
+	for (auto& sh : shdr) {
+		if (sh.sh_type != SHT_SYMTAB || sh.sh_link >= shdr.size())
+			continue;
+
+		// symbol names live in the linked string table
+		Elf32_Shdr& strtab = shdr[sh.sh_link];
+		vector<char> strs(strtab.sh_size + 1);
+		in.seekg(strtab.sh_offset, ios::beg);
+		in.read(strs.data(), strtab.sh_size);
+
+		size_t nsym = sh.sh_size / sizeof(Elf32_Sym);
+		in.seekg(sh.sh_offset, ios::beg);
+		for (size_t i = 0; i < nsym; ++i) {
+			Elf32_Sym sym;
+			in.read((char*)(&sym), sizeof(Elf32_Sym));
+			if (sym.st_name < strtab.sh_size
+				&& strcmp(&strs[sym.st_name], name) == 0) {
+				addr = sym.st_value;
+				return true;
+			}
+		}
+	}
+	return false;
+}
@@ -3,6 +3,9 @@
 #include <stdint.h>
 
 #define PT_LOAD 1
+#define PF_X 1
+
+#define SHT_SYMTAB 2
 
 #define AT_NULL   0
 #define AT_PHDR   3
@@ -43,5 +46,33 @@ typedef struct
 	uint32_t p_align;
 } Elf32_Phdr;
 
+typedef struct
+{
+	uint32_t sh_name;
+	uint32_t sh_type;
+	uint32_t sh_flags;
+	uint32_t sh_addr;
+	uint32_t sh_offset;
+	uint32_t sh_size;
+	uint32_t sh_link;
+	uint32_t sh_info;
+	uint32_t sh_addralign;
+	uint32_t sh_entsize;
+} Elf32_Shdr;
+
+typedef struct
+{
+	uint32_t st_name;
+	uint32_t st_value;
+	uint32_t st_size;
+	uint8_t  st_info;
+	uint8_t  st_other;
+	uint16_t st_shndx;
+} Elf32_Sym;
+
 void load_elf(const char* fn, uint32_t& entry_point, uint32_t& base_vaddr
-	, uint32_t& max_addr, char*& memory, char*& stack, uint32_t& sp);
+	, uint32_t& max_addr, char*& memory, char*& stack, uint32_t& sp
+	, uint32_t& text_base, uint32_t& text_end
+	, uint32_t heap_size, uint32_t stack_size);
+
+bool find_symbol(const char* fn, const char* name, uint32_t& addr);
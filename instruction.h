@@ -146,6 +146,11 @@ public:
 	Fields fields;
 	Function function{ Function::ADDI };
     bool taken{ false };	
+	// branch predictor checkpoint, see BranchPredictor::predict
+	uint32_t checkpoint{ 0 };
+	// predicted fetch address after a JALR and the return stack after this insn
+	uint32_t next_pc{ 0 };
+	uint32_t ras_top{ 0 }, ras_value{ 0 };
 
 	Instruction(uint32_t v) : value(v) {}
 
@@ -0,0 +1,272 @@
+#include "iss.h"
+#include "rv32m.h"
+#include "syscall.h"
+#include <iostream>
+
+int32_t ISS::alu(const Instruction& insn, int32_t A, int32_t B)
+{
+	int32_t imm = int32_t(insn.fields.imm);
+
+	switch (insn.function)
+	{
+	case Function::ADD:
+		return A + B;
+	case Function::SUB:
+		return A - B;
+	case Function::SLL:
+		return (A << (B & 0x1f));
+	case Function::SRA:
+		return (A >> (B & 0x1f));
+	case Function::SRL:
+		return uint32_t(A) >> (B & 0x1f);
+	case Function::XOR:
+		return A ^ B;
+	case Function::OR:
+		return A | B;
+	case Function::AND:
+		return A & B;
+	case Function::SLT:
+		return int32_t(A < B);
+	case Function::SLTU:
+		return int32_t(uint32_t(A) < uint32_t(B));
+
+	case Function::ADDI:
+		return A + imm;
+	case Function::XORI:
+		return A ^ imm;
+	case Function::ORI:
+		return A | imm;
+	case Function::ANDI:
+		return A & imm;
+	case Function::SLLI:
+		return (A << insn.fields.imm);
+	case Function::SRLI:
+		return uint32_t(A) >> insn.fields.imm;
+	case Function::SRAI:
+		return (A >> insn.fields.imm);
+	case Function::SLTI:
+		return int32_t(A < imm);
+	case Function::SLTIU:
+		return int32_t(uint32_t(A) < insn.fields.imm);
+
+	case Function::BEQ:
+		return int32_t(A == B);
+	case Function::BNE:
+		return int32_t(A != B);
+	case Function::BLT:
+		return int32_t(A < B);
+	case Function::BGE:
+		return int32_t(A >= B);
+	case Function::BLTU:
+		return int32_t(uint32_t(A) < uint32_t(B));
+	case Function::BGEU:
+		return int32_t(uint32_t(A) >= uint32_t(B));
+	default:
+		return 0;
+	}
+}
+
+float ISS::fpu(const Instruction& insn, float A, float B)
+{
+	switch (insn.function)
+	{
+	case Function::FADD_S:
+		return A + B;
+	case Function::FSUB_S:
+		return A - B;
+	case Function::FMUL_S:
+		return A * B;
+	case Function::FDIV_S:
+		return A / B;
+	default:
+		return 0.f;
+	}
+}
+
+int32_t ISS::read_memory(const Instruction& insn, uint32_t addr)
+{
+	switch (insn.function)
+	{
+	case Function::LB:
+		return memory->read_int(addr, BYTE_SIZE);
+	case Function::LH:
+		return memory->read_int(addr, HALFWORD_SIZE);
+	case Function::LBU:
+		return memory->read_int(addr, BYTE_SIZE, false);
+	case Function::LHU:
+		return memory->read_int(addr, HALFWORD_SIZE, false);
+	default:
+		return memory->read_int(addr, WORD_SIZE);
+	}
+}
+
+void ISS::write_memory(const Instruction& insn, uint32_t addr, int32_t value)
+{
+	switch (insn.function)
+	{
+	case Function::SB:
+		memory->write(addr, BYTE_SIZE, (uint32_t*)&value);
+		break;
+	case Function::SH:
+		memory->write(addr, HALFWORD_SIZE, (uint32_t*)&value);
+		break;
+	default:
+		memory->write(addr, WORD_SIZE, (uint32_t*)&value);
+		break;
+	}
+}
+
+// returns the value loaded into rd
+int32_t ISS::amo(const Instruction& insn, uint32_t addr, int32_t src)
+{
+	if (insn.function == Function::SC_W) {
+		memory->write(addr, WORD_SIZE, (uint32_t*)&src);
+		return 0;
+	}
+
+	int32_t load_value = memory->read_int(addr, WORD_SIZE);
+	int32_t result = load_value;
+	switch (insn.function)
+	{
+	case Function::LR_W:
+		return load_value;
+	case Function::AMOSWAP_W:
+		result = src;
+		break;
+	case Function::AMOADD_W:
+		result = load_value + src;
+		break;
+	case Function::AMOXOR_W:
+		result = load_value ^ src;
+		break;
+	case Function::AMOAND_W:
+		result = load_value & src;
+		break;
+	case Function::AMOOR_W:
+		result = load_value | src;
+		break;
+	case Function::AMOMIN_W:
+		result = (load_value < src) ? load_value : src;
+		break;
+	case Function::AMOMAX_W:
+		result = (load_value > src) ? load_value : src;
+		break;
+	case Function::AMOMINU_W:
+		result = (uint32_t(load_value) < uint32_t(src)) ? load_value : src;
+		break;
+	case Function::AMOMAXU_W:
+		result = (uint32_t(load_value) > uint32_t(src)) ? load_value : src;
+		break;
+	default:
+		break;
+	}
+	memory->write(addr, WORD_SIZE, (uint32_t*)&result);
+	return load_value;
+}
+
+void ISS::step()
+{
+	uint32_t pc = uint32_t(register_file.pc);
+	Instruction insn = memory->fetch_insn(pc);
+
+	const Fields& f = insn.fields;
+	int32_t A = register_file.gpr[f.rs1];
+	int32_t B = register_file.gpr[f.rs2];
+	int32_t imm = int32_t(f.imm);
+	uint32_t next_pc = pc + WORD_SIZE;
+
+	++instret;
+
+	switch (insn.opcode)
+	{
+	case Opcode::LUI:
+		write_gpr(f.rd, imm);
+		break;
+	case Opcode::AUIPC:
+		write_gpr(f.rd, int32_t(pc) + imm);
+		break;
+	case Opcode::JAL:
+		write_gpr(f.rd, int32_t(next_pc));
+		next_pc = pc + imm;
+		break;
+	case Opcode::JALR:
+		write_gpr(f.rd, int32_t(next_pc));
+		next_pc = (A + imm) & 0xfffffffe; // LSB -> 0
+		break;
+	case Opcode::BRANCH:
+		if (alu(insn, A, B))
+			next_pc = pc + imm;
+		break;
+	case Opcode::LOAD:
+		write_gpr(f.rd, read_memory(insn, A + imm));
+		break;
+	case Opcode::STORE:
+		write_memory(insn, A + imm, B);
+		break;
+	case Opcode::LOAD_FP:
+		register_file.fpr[f.rd] = memory->read_float(A + imm);
+		break;
+	case Opcode::STORE_FP:
+		memory->write(A + imm, WORD_SIZE, (uint32_t*)&register_file.fpr[f.rs2]);
+		break;
+	case Opcode::OP_FP:
+		register_file.fpr[f.rd] = fpu(insn
+			, register_file.fpr[f.rs1], register_file.fpr[f.rs2]);
+		break;
+	case Opcode::OP_IMM:
+		write_gpr(f.rd, alu(insn, A, B));
+		break;
+	case Opcode::OP:
+		if (f.funct7 == 0b0000001)
+			write_gpr(f.rd, rv32m(insn.function, A, B));
+		else
+			write_gpr(f.rd, alu(insn, A, B));
+		break;
+	case Opcode::AMO:
+		write_gpr(f.rd, amo(insn, A, B));
+		break;
+	case Opcode::SYSTEM:
+		if (insn.function == Function::ECALL)
+			handle_syscall(register_file, *memory, instret);
+		break;
+	case Opcode::FENCE:
+		if (insn.function == Function::FENCE_I)
+			memory->flush_decode_cache();
+		break;
+	default:
+		break;
+	}
+
+	register_file.pc = next_pc;
+}
+
+bool ISS::reached(const SwitchPoint& point) const
+{
+	if (point.use_count && instret >= point.insn_count)
+		return true;
+	if (point.use_pc && uint32_t(register_file.pc) == point.pc)
+		return true;
+	return false;
+}
+
+void ISS::run_until(const SwitchPoint& point)
+{
+	// whole blocks first, single steps across the block holding the point
+	while (!reached(point)) {
+		block_cache.run(point, instret);
+		if (!reached(point))
+			step();
+	}
+
+	std::clog << "fast-forwarded " << std::dec << instret
+		<< " instructions to pc " << std::hex << register_file.pc << std::endl;
+}
+
+void ISS::run()
+{
+	SwitchPoint never;
+	while (true) {
+		block_cache.run(never, instret);
+		step();
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "instruction.h"
+#include "consts.h"
+#include "memory.h"
+#include "registers.h"
+#include "block_cache.h"
+
+// point at which the functional run hands over to a timing model
+struct SwitchPoint {
+	bool use_count{ false };
+	unsigned long long insn_count{ 0 };
+
+	bool use_pc{ false };
+	uint32_t pc{ 0 };
+};
+
+// Instruction set simulator
+// executes one instruction per step without any pipeline state
+class ISS {
+	Memory* memory{ nullptr };
+	RegisterFile register_file;
+	unsigned long long instret{ 0 };
+
+	// translated basic blocks for the threaded-dispatch path
+	BlockCache block_cache;
+
+private:
+	int32_t alu(const Instruction& insn, int32_t A, int32_t B);
+	float fpu(const Instruction& insn, float A, float B);
+	int32_t read_memory(const Instruction& insn, uint32_t addr);
+	void write_memory(const Instruction& insn, uint32_t addr, int32_t value);
+	int32_t amo(const Instruction& insn, uint32_t addr, int32_t src);
+
+	void write_gpr(uint32_t rd, int32_t value) {
+		if (rd != 0) register_file.gpr[rd] = value;
+	}
+
+public:
+	ISS(Memory* mem, uint32_t entry_point, uint32_t sp, bool jit = true)
+		: memory(mem), block_cache(mem, &register_file, jit) {
+		register_file.pc = entry_point;
+		register_file.gpr[2] = sp;
+	}
+
+	void step();
+	bool reached(const SwitchPoint& point) const;
+	void run_until(const SwitchPoint& point);
+	void run();
+
+	const RegisterFile& get_register_file() const { return register_file; }
+	unsigned long long get_instret() const { return instret; }
+};
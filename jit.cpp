@@ -0,0 +1,378 @@
+#include "jit.h"
+#include "block_cache.h"
+#include "rv32m.h"
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(USE_JIT) && defined(__x86_64__)
+#define JIT_ENABLED 1
+#endif
+
+// host helpers called from translated code
+static int32_t jit_lb(Memory* m, uint32_t a) { return m->read_int(a, BYTE_SIZE); }
+static int32_t jit_lh(Memory* m, uint32_t a) { return m->read_int(a, HALFWORD_SIZE); }
+static int32_t jit_lw(Memory* m, uint32_t a) { return m->read_int(a, WORD_SIZE); }
+static int32_t jit_lbu(Memory* m, uint32_t a) { return m->read_int(a, BYTE_SIZE, false); }
+static int32_t jit_lhu(Memory* m, uint32_t a) { return m->read_int(a, HALFWORD_SIZE, false); }
+static float jit_flw(Memory* m, uint32_t a) { return m->read_float(a); }
+
+static void jit_sb(Memory* m, uint32_t a, uint32_t v) { m->write(a, BYTE_SIZE, &v); }
+static void jit_sh(Memory* m, uint32_t a, uint32_t v) { m->write(a, HALFWORD_SIZE, &v); }
+static void jit_sw(Memory* m, uint32_t a, uint32_t v) { m->write(a, WORD_SIZE, &v); }
+
+static uint32_t gpr_offset(uint32_t r) { return offsetof(RegisterFile, gpr) + r * sizeof(int32_t); }
+static uint32_t fpr_offset(uint32_t r) { return offsetof(RegisterFile, fpr) + r * sizeof(float); }
+
+// x86 register numbers
+#define EAX 0
+#define ECX 1
+#define EDX 2
+#define ESI 6
+#define EDI 7
+
+Jit::Jit(Memory* mem) : memory(mem)
+{
+#ifdef JIT_ENABLED
+	// never writable and executable at once, see compile()
+	void* p = mmap(nullptr, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE
+		, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p != MAP_FAILED)
+		arena = (uint8_t*)p;
+#endif
+}
+
+Jit::~Jit()
+{
+	if (arena)
+		munmap(arena, JIT_ARENA_SIZE);
+}
+
+bool Jit::available()
+{
+#ifdef JIT_ENABLED
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Jit::emit32(uint32_t v)
+{
+	for (int i = 0; i < 4; ++i)
+		emit8(uint8_t(v >> (8 * i)));
+}
+
+void Jit::emit64(uint64_t v)
+{
+	for (int i = 0; i < 8; ++i)
+		emit8(uint8_t(v >> (8 * i)));
+}
+
+// mov reg32, [rbx + gpr(rs)]
+void Jit::load_gpr(uint8_t reg, uint32_t rs)
+{
+	if (rs == 0) {
+		// xor reg, reg
+		emit8(0x31); emit8(0xc0 | (reg << 3) | reg);
+		return;
+	}
+	emit8(0x8b); emit8(0x80 | (reg << 3) | 3); emit32(gpr_offset(rs));
+}
+
+// mov [rbx + gpr(rd)], eax
+void Jit::store_eax(uint32_t rd)
+{
+	if (rd == 0) return;
+	emit8(0x89); emit8(0x83); emit32(gpr_offset(rd));
+}
+
+// op eax, [rbx + gpr(rs)]
+void Jit::alu_mem(uint8_t opcode, uint32_t rs)
+{
+	emit8(opcode); emit8(0x83); emit32(gpr_offset(rs));
+}
+
+// op eax, imm32
+void Jit::alu_imm(uint8_t opcode, int32_t imm)
+{
+	emit8(opcode); emit32(uint32_t(imm));
+}
+
+// setcc al; movzx eax, al; store
+void Jit::set_cc(uint8_t cc, uint32_t rd)
+{
+	emit8(0x0f); emit8(cc); emit8(0xc0);
+	emit8(0x0f); emit8(0xb6); emit8(0xc0);
+	store_eax(rd);
+}
+
+// mov rax, fn; call rax
+void Jit::call(const void* fn)
+{
+	emit8(0x48); emit8(0xb8); emit64(uint64_t(uintptr_t(fn)));
+	emit8(0xff); emit8(0xd0);
+}
+
+// movss xmm0, fs1; op xmm0, fs2; movss fd, xmm0
+void Jit::fp_op(uint8_t opcode, const Instruction& insn)
+{
+	emit8(0xf3); emit8(0x0f); emit8(0x10); emit8(0x83); emit32(fpr_offset(insn.fields.rs1));
+	emit8(0xf3); emit8(0x0f); emit8(opcode); emit8(0x83); emit32(fpr_offset(insn.fields.rs2));
+	emit8(0xf3); emit8(0x0f); emit8(0x11); emit8(0x83); emit32(fpr_offset(insn.fields.rd));
+}
+
+void Jit::epilogue()
+{
+	// pop r13; pop r12; pop rbx; ret
+	emit8(0x41); emit8(0x5d);
+	emit8(0x41); emit8(0x5c);
+	emit8(0x5b);
+	emit8(0xc3);
+}
+
+// AMO, ECALL and FENCE.I stay with the interpreter
+bool Jit::translatable(const Instruction& insn)
+{
+	switch (insn.opcode)
+	{
+	case Opcode::AMO:
+	case Opcode::SYSTEM:
+		return false;
+	case Opcode::FENCE:
+		return insn.function != Function::FENCE_I;
+	default:
+		return true;
+	}
+}
+
+// returns true when insn ends the block with the next pc in eax
+bool Jit::translate(const Instruction& insn)
+{
+	const Fields& f = insn.fields;
+	int32_t imm = int32_t(f.imm);
+
+	switch (insn.function)
+	{
+	case Function::LUI:
+	case Function::AUIPC:
+		if (f.rd != 0) {
+			// mov dword [rbx + gpr(rd)], imm32
+			emit8(0xc7); emit8(0x83); emit32(gpr_offset(f.rd));
+			emit32(insn.function == Function::LUI ? uint32_t(imm) : f.pc + imm);
+		}
+		return false;
+
+	case Function::JAL:
+		if (f.rd != 0) {
+			emit8(0xc7); emit8(0x83); emit32(gpr_offset(f.rd)); emit32(f.pc + WORD_SIZE);
+		}
+		emit8(0xb8); emit32(f.pc + imm);
+		return true;
+	case Function::JALR:
+		load_gpr(EAX, f.rs1);
+		alu_imm(0x05, imm);
+		alu_imm(0x25, int32_t(0xfffffffe)); // LSB -> 0
+		if (f.rd != 0) {
+			emit8(0xc7); emit8(0x83); emit32(gpr_offset(f.rd)); emit32(f.pc + WORD_SIZE);
+		}
+		return true;
+
+	case Function::BEQ:
+	case Function::BNE:
+	case Function::BLT:
+	case Function::BGE:
+	case Function::BLTU:
+	case Function::BGEU: {
+		uint8_t cmov = 0x44;
+		switch (insn.function) {
+		case Function::BEQ: cmov = 0x44; break;
+		case Function::BNE: cmov = 0x45; break;
+		case Function::BLT: cmov = 0x4c; break;
+		case Function::BGE: cmov = 0x4d; break;
+		case Function::BLTU: cmov = 0x42; break;
+		default: cmov = 0x43; break;
+		}
+		load_gpr(EAX, f.rs1);
+		alu_mem(0x3b, f.rs2);					// cmp eax, rs2
+		emit8(0xb8); emit32(f.pc + WORD_SIZE);	// mov eax, fall-through
+		emit8(0xb9); emit32(f.pc + imm);		// mov ecx, target
+		emit8(0x0f); emit8(cmov); emit8(0xc1);	// cmovcc eax, ecx
+		return true;
+	}
+
+	case Function::LB:
+	case Function::LH:
+	case Function::LW:
+	case Function::LBU:
+	case Function::LHU:
+	case Function::FLW: {
+		emit8(0x4c); emit8(0x89); emit8(0xef);	// mov rdi, r13
+		load_gpr(ESI, f.rs1);
+		emit8(0x81); emit8(0xc6); emit32(uint32_t(imm)); // add esi, imm
+		switch (insn.function) {
+		case Function::LB: call((const void*)jit_lb); break;
+		case Function::LH: call((const void*)jit_lh); break;
+		case Function::LW: call((const void*)jit_lw); break;
+		case Function::LBU: call((const void*)jit_lbu); break;
+		case Function::LHU: call((const void*)jit_lhu); break;
+		default: call((const void*)jit_flw); break;
+		}
+		if (insn.function == Function::FLW) {
+			emit8(0xf3); emit8(0x0f); emit8(0x11); emit8(0x83); emit32(fpr_offset(f.rd));
+		}
+		else
+			store_eax(f.rd);
+		return false;
+	}
+
+	case Function::SB:
+	case Function::SH:
+	case Function::SW:
+	case Function::FSW:
+		emit8(0x4c); emit8(0x89); emit8(0xef);	// mov rdi, r13
+		load_gpr(ESI, f.rs1);
+		emit8(0x81); emit8(0xc6); emit32(uint32_t(imm)); // add esi, imm
+		if (insn.function == Function::FSW) {
+			emit8(0x8b); emit8(0x93); emit32(fpr_offset(f.rs2)); // mov edx, fpr(rs2)
+		}
+		else
+			load_gpr(EDX, f.rs2);
+		switch (insn.function) {
+		case Function::SB: call((const void*)jit_sb); break;
+		case Function::SH: call((const void*)jit_sh); break;
+		default: call((const void*)jit_sw); break;
+		}
+		return false;
+
+	case Function::ADDI: load_gpr(EAX, f.rs1); alu_imm(0x05, imm); store_eax(f.rd); return false;
+	case Function::XORI: load_gpr(EAX, f.rs1); alu_imm(0x35, imm); store_eax(f.rd); return false;
+	case Function::ORI: load_gpr(EAX, f.rs1); alu_imm(0x0d, imm); store_eax(f.rd); return false;
+	case Function::ANDI: load_gpr(EAX, f.rs1); alu_imm(0x25, imm); store_eax(f.rd); return false;
+	case Function::SLTI: load_gpr(EAX, f.rs1); alu_imm(0x3d, imm); set_cc(0x9c, f.rd); return false;
+	case Function::SLTIU: load_gpr(EAX, f.rs1); alu_imm(0x3d, imm); set_cc(0x92, f.rd); return false;
+	case Function::SLLI:
+	case Function::SRLI:
+	case Function::SRAI:
+		load_gpr(EAX, f.rs1);
+		emit8(0xc1);
+		emit8(insn.function == Function::SLLI ? 0xe0 : (insn.function == Function::SRLI ? 0xe8 : 0xf8));
+		emit8(uint8_t(f.imm & 0x1f));
+		store_eax(f.rd);
+		return false;
+
+	case Function::ADD: load_gpr(EAX, f.rs1); alu_mem(0x03, f.rs2); store_eax(f.rd); return false;
+	case Function::SUB: load_gpr(EAX, f.rs1); alu_mem(0x2b, f.rs2); store_eax(f.rd); return false;
+	case Function::XOR: load_gpr(EAX, f.rs1); alu_mem(0x33, f.rs2); store_eax(f.rd); return false;
+	case Function::OR: load_gpr(EAX, f.rs1); alu_mem(0x0b, f.rs2); store_eax(f.rd); return false;
+	case Function::AND: load_gpr(EAX, f.rs1); alu_mem(0x23, f.rs2); store_eax(f.rd); return false;
+	case Function::SLT: load_gpr(EAX, f.rs1); alu_mem(0x3b, f.rs2); set_cc(0x9c, f.rd); return false;
+	case Function::SLTU: load_gpr(EAX, f.rs1); alu_mem(0x3b, f.rs2); set_cc(0x92, f.rd); return false;
+	case Function::SLL:
+	case Function::SRL:
+	case Function::SRA:
+		load_gpr(EAX, f.rs1);
+		load_gpr(ECX, f.rs2);
+		emit8(0xd3);
+		emit8(insn.function == Function::SLL ? 0xe0 : (insn.function == Function::SRL ? 0xe8 : 0xf8));
+		store_eax(f.rd);
+		return false;
+
+	case Function::MUL:
+		load_gpr(EAX, f.rs1);
+		emit8(0x0f); emit8(0xaf); emit8(0x83); emit32(gpr_offset(f.rs2)); // imul eax, rs2
+		store_eax(f.rd);
+		return false;
+	case Function::MULH:
+	case Function::MULHSU:
+	case Function::MULHU:
+		if (insn.function == Function::MULHU)
+			load_gpr(EAX, f.rs1);
+		else {
+			emit8(0x48); emit8(0x63); emit8(0x83); emit32(gpr_offset(f.rs1)); // movsxd rax, rs1
+		}
+		if (insn.function == Function::MULH) {
+			emit8(0x48); emit8(0x63); emit8(0x8b); emit32(gpr_offset(f.rs2)); // movsxd rcx, rs2
+		}
+		else
+			load_gpr(ECX, f.rs2);
+		emit8(0x48); emit8(0x0f); emit8(0xaf); emit8(0xc1);	// imul rax, rcx
+		emit8(0x48); emit8(0xc1);
+		emit8(insn.function == Function::MULHU ? 0xe8 : 0xf8); emit8(32); // shr/sar rax, 32
+		store_eax(f.rd);
+		return false;
+	case Function::DIV:
+	case Function::DIVU:
+	case Function::REM:
+	case Function::REMU:
+		load_gpr(EDI, f.rs1);
+		load_gpr(ESI, f.rs2);
+		switch (insn.function) {
+		case Function::DIV: call((const void*)rv32m_div); break;
+		case Function::DIVU: call((const void*)rv32m_divu); break;
+		case Function::REM: call((const void*)rv32m_rem); break;
+		default: call((const void*)rv32m_remu); break;
+		}
+		store_eax(f.rd);
+		return false;
+
+	case Function::FADD_S: fp_op(0x58, insn); return false;
+	case Function::FSUB_S: fp_op(0x5c, insn); return false;
+	case Function::FMUL_S: fp_op(0x59, insn); return false;
+	case Function::FDIV_S: fp_op(0x5e, insn); return false;
+
+	default:
+		// FENCE, NOP
+		return false;
+	}
+}
+
+JitCode Jit::compile(const Block& b)
+{
+#ifdef JIT_ENABLED
+	if (!arena)
+		return nullptr;
+
+	std::vector<Instruction> insns;
+	for (uint32_t pc = b.start; pc < b.end; pc += WORD_SIZE) {
+		insns.emplace_back(memory->fetch_insn(pc));
+		if (!translatable(insns.back()))
+			return nullptr;
+	}
+
+	code.clear();
+	// push rbx; push r12 (keeps the stack 16-byte aligned); push r13
+	emit8(0x53);
+	emit8(0x41); emit8(0x54);
+	emit8(0x41); emit8(0x55);
+	emit8(0x48); emit8(0x89); emit8(0xfb);	// mov rbx, rdi (RegisterFile*)
+	emit8(0x49); emit8(0x89); emit8(0xf5);	// mov r13, rsi (Memory*)
+
+	bool ended = false;
+	for (const Instruction& insn : insns)
+		ended = translate(insn);
+	if (!ended) {
+		emit8(0xb8); emit32(b.end);			// mov eax, end
+	}
+	epilogue();
+
+	if (used + code.size() > JIT_ARENA_SIZE)
+		return nullptr;
+
+	// the pages the block lands on are writable only while it is copied in
+	uintptr_t page = uintptr_t(sysconf(_SC_PAGESIZE));
+	uint8_t* first = arena + (used & ~(page - 1));
+	size_t length = arena + used + code.size() - first;
+	if (mprotect(first, length, PROT_READ | PROT_WRITE) != 0)
+		return nullptr;
+	memcpy(arena + used, code.data(), code.size());
+	if (mprotect(first, length, PROT_READ | PROT_EXEC) != 0)
+		return nullptr;
+	JitCode fn = (JitCode)(arena + used);
+	used += (code.size() + 15) & ~size_t(15);
+	return fn;
+#else
+	return nullptr;
+#endif
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "instruction.h"
+#include "memory.h"
+#include "registers.h"
+#include <stddef.h>
+#include <vector>
+
+#define JIT_THRESHOLD 16
+#define JIT_ARENA_SIZE (16 * 1024 * 1024)
+
+struct Block;
+
+// returns the next guest pc
+typedef uint32_t (*JitCode)(RegisterFile* rf, Memory* mem);
+
+// Translates hot RV32IM(F) blocks into x86-64 host code.
+// Guest registers stay in RegisterFile; memory goes through helper calls.
+class Jit {
+	Memory* memory{ nullptr };
+
+	uint8_t* arena{ nullptr };
+	size_t used{ 0 };
+
+	std::vector<uint8_t> code;
+
+private:
+	void emit8(uint8_t b) { code.push_back(b); }
+	void emit32(uint32_t v);
+	void emit64(uint64_t v);
+
+	void load_gpr(uint8_t reg, uint32_t rs);
+	void store_eax(uint32_t rd);
+	void alu_mem(uint8_t opcode, uint32_t rs);
+	void alu_imm(uint8_t opcode, int32_t imm);
+	void set_cc(uint8_t cc, uint32_t rd);
+	void call(const void* fn);
+	void fp_op(uint8_t opcode, const Instruction& insn);
+	void epilogue();
+
+	bool translatable(const Instruction& insn);
+	bool translate(const Instruction& insn);
+
+public:
+	Jit(Memory* mem);
+	~Jit();
+
+	static bool available();
+
+	JitCode compile(const Block& b);
+	void reset() { used = 0; }
+};
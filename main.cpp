@@ -1,28 +1,395 @@
 #include <iostream>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
 #include "elf.h"
 #include "memory.h"
+#include "iss.h"
+#include "cache.h"
+#include "branch_predictor.h"
+#include "syscall.h"
 #include "pipeline.h"
 #include "tomasulo.h"
-#include "tomasulo_2.h"
 
 using namespace std;
 
 char* memory;
 char* stack;
 
+// switch-over point: instruction count, 0x<pc> or symbol name
+bool parse_switch_point(const char* fn, const char* arg, SwitchPoint& point)
+{
+	char* end = nullptr;
+	if (arg[0] == '0' && (arg[1] == 'x' || arg[1] == 'X')) {
+		point.use_pc = true;
+		point.pc = strtoul(arg, &end, 16);
+		return *end == '\0';
+	}
+	if (isdigit(arg[0])) {
+		point.use_count = true;
+		point.insn_count = strtoull(arg, &end, 10);
+		return *end == '\0';
+	}
+	point.use_pc = true;
+	return find_symbol(fn, arg, point.pc);
+}
+
+// decimal or 0x number with an optional K/M/G suffix; a leading 0 is not octal
+unsigned long long parse_number(const char* arg, char*& end)
+{
+	bool hex = arg[0] == '0' && (arg[1] == 'x' || arg[1] == 'X');
+	unsigned long long v = strtoull(arg, &end, hex ? 16 : 10);
+	switch (*end) {
+	case 'G': case 'g': v <<= 10;
+		[[fallthrough]];
+	case 'M': case 'm': v <<= 10;
+		[[fallthrough]];
+	case 'K': case 'k': v <<= 10; ++end;
+	}
+	return v;
+}
+
+// size rounded up to whole pages
+bool parse_size(const char* arg, uint32_t& size)
+{
+	char* end = nullptr;
+	unsigned long long v = parse_number(arg, end);
+	if (*end != '\0' || v == 0 || v >= 0xf0000000ULL)
+		return false;
+	size = uint32_t((v + PAGE_MASK) & ~(unsigned long long)PAGE_MASK);
+	return true;
+}
+
+// <size>[:<assoc>[:<line size>[:lru|fifo|random[:<hit latency>]]]]
+bool parse_cache(const char* arg, CacheConfig& config)
+{
+	char* end = nullptr;
+	config.size = uint32_t(parse_number(arg, end));
+	if (*end == ':')
+		config.assoc = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.line_size = strtoul(end + 1, &end, 10);
+	if (*end == ':') {
+		++end;
+		if (strncmp(end, "lru", 3) == 0)
+			config.policy = Replacement::LRU, end += 3;
+		else if (strncmp(end, "fifo", 4) == 0)
+			config.policy = Replacement::FIFO, end += 4;
+		else if (strncmp(end, "random", 6) == 0)
+			config.policy = Replacement::RANDOM, end += 6;
+		else
+			return false;
+	}
+	if (*end == ':')
+		config.hit_latency = strtoul(end + 1, &end, 10);
+	return *end == '\0' && config.size != 0 && config.hit_latency != 0;
+}
+
+// bimodal|gshare|tournament|tage[:<entries>[:<history bits>]]
+bool parse_predictor(const char* arg, PredictorConfig& config)
+{
+	const char* end = arg;
+	if (strncmp(arg, "bimodal", 7) == 0)
+		config.kind = PredictorKind::BIMODAL, end += 7;
+	else if (strncmp(arg, "gshare", 6) == 0)
+		config.kind = PredictorKind::GSHARE, end += 6;
+	else if (strncmp(arg, "tournament", 10) == 0)
+		config.kind = PredictorKind::TOURNAMENT, end += 10;
+	else if (strncmp(arg, "tage", 4) == 0)
+		config.kind = PredictorKind::TAGE, config.history_bits = TAGE_MAX_HISTORY, end += 4;
+	else
+		return false;
+
+	char* next = const_cast<char*>(end);
+	if (*next == ':')
+		config.table_size = uint32_t(parse_number(next + 1, next));
+	if (*next == ':')
+		config.history_bits = strtoul(next + 1, &next, 10);
+	return *next == '\0';
+}
+
+// <alu>[:<muldiv>[:<addr>[:<load>[:<store queue>[:<fp>]]]]] entries
+bool parse_scheduler(const char* arg, SchedulerConfig& config)
+{
+	char* end = nullptr;
+	config.alu_entries = strtoul(arg, &end, 10);
+	if (*end == ':')
+		config.muldiv_entries = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.addr_entries = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.load_entries = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.store_entries = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.fp_entries = strtoul(end + 1, &end, 10);
+	uint32_t entries[] = { config.alu_entries, config.muldiv_entries, config.addr_entries, config.load_entries, config.fp_entries };
+	for (uint32_t n : entries) {
+		if (n == 0 || n > MAX_RS_ENTRIES)
+			return false;
+	}
+	return *end == '\0' && config.store_entries != 0;
+}
+
+// <alu>[:<muldiv>[:<addr>[:<memory ports>[:<fp>]]]] functional units
+bool parse_units(const char* arg, SchedulerConfig& config)
+{
+	char* end = nullptr;
+	config.alu_units = strtoul(arg, &end, 10);
+	if (*end == ':')
+		config.muldiv_units = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.addr_units = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.mem_ports = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.fp_units = strtoul(end + 1, &end, 10);
+	return *end == '\0' && config.alu_units != 0 && config.muldiv_units != 0
+		&& config.addr_units != 0 && config.mem_ports != 0 && config.fp_units != 0;
+}
+
+// <issue>[:<dispatch>[:<CDB>[:<commit>]]]
+bool parse_core(const char* arg, CoreConfig& config)
+{
+	char* end = nullptr;
+	config.issue_width = strtoul(arg, &end, 10);
+	if (*end == ':')
+		config.dispatch_width = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.cdb_width = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.commit_width = strtoul(end + 1, &end, 10);
+	return *end == '\0' && config.issue_width != 0 && config.dispatch_width != 0
+		&& config.cdb_width != 0 && config.commit_width != 0;
+}
+
+bool parse_rename(const char* arg, RenameConfig& config)
+{
+	char* end = nullptr;
+	config.registers = strtoul(arg, &end, 10);
+	if (*end == ':')
+		config.checkpoints = strtoul(end + 1, &end, 10);
+	return *end == '\0' && config.registers > LOGICAL_REGS && config.registers <= 0x10000 && config.checkpoints != 0;
+}
+
+// <SSIT entries>[:<LFST entries>], 0 turns speculative loads off
+bool parse_store_sets(const char* arg, StoreSetConfig& config)
+{
+	char* end = nullptr;
+	config.ssit_entries = strtoul(arg, &end, 10);
+	if (*end == ':')
+		config.lfst_entries = strtoul(end + 1, &end, 10);
+	return *end == '\0' && (config.ssit_entries & (config.ssit_entries - 1)) == 0
+		&& config.lfst_entries != 0;
+}
+
+// <mul|div|fadd|fmul|fdiv>:<latency>[:<initiation interval>] of type 0; the
+// interval defaults to 1, or to the latency for the dividers
+bool parse_unit_timing(const char* arg, PipelineConfig& config)
+{
+	struct { const char* name; UnitTiming* timing; bool divider; } units[] = {
+		{ "mul", &config.mul, false }, { "div", &config.div, true },
+		{ "fadd", &config.fpadd, false }, { "fmul", &config.fpmul, false },
+		{ "fdiv", &config.fpdiv, true }
+	};
+	const char* colon = strchr(arg, ':');
+	if (!colon)
+		return false;
+	for (auto& unit : units) {
+		if (strlen(unit.name) != size_t(colon - arg) || strncmp(arg, unit.name, colon - arg) != 0)
+			continue;
+		char* end = nullptr;
+		unit.timing->latency = strtoul(colon + 1, &end, 10);
+		unit.timing->interval = unit.divider ? unit.timing->latency : 1;
+		if (*end == ':')
+			unit.timing->interval = strtoul(end + 1, &end, 10);
+		return *end == '\0' && unit.timing->latency != 0 && unit.timing->interval != 0;
+	}
+	return false;
+}
+
+// all, none or a comma separated list of ex|mem|wb[.alu|muldiv|fpadd|fpmul|fpdiv]:
+// the EX->EX, MEM->EX and WB->ID bypasses of type 0 that stay on
+bool parse_bypass(const char* arg, PipelineConfig& config)
+{
+	const char* paths[BYPASS_PATHS] = { "ex", "mem", "wb" };
+	const char* units[RESULT_UNITS] = { "alu", "muldiv", "fpadd", "fpmul", "fpdiv" };
+	uint32_t all = (1u << RESULT_UNITS) - 1;
+	if (strcmp(arg, "all") == 0) {
+		std::fill(config.bypass, config.bypass + BYPASS_PATHS, all);
+		return true;
+	}
+	std::fill(config.bypass, config.bypass + BYPASS_PATHS, 0);
+	if (strcmp(arg, "none") == 0)
+		return true;
+
+	for (const char* p = arg; *p; ) {
+		const char* comma = strchr(p, ',');
+		string item = comma ? string(p, comma) : string(p);
+		size_t dot = item.find('.');
+		string path = item.substr(0, dot);
+		int n = 0;
+		while (n < BYPASS_PATHS && path != paths[n])
+			++n;
+		if (n == BYPASS_PATHS)
+			return false;
+		if (dot == string::npos)
+			config.bypass[n] = all;
+		else {
+			int u = 0;
+			while (u < RESULT_UNITS && item.substr(dot + 1) != units[u])
+				++u;
+			if (u == RESULT_UNITS)
+				return false;
+			config.bypass[n] |= 1u << u;
+		}
+		p = comma ? comma + 1 : "";
+	}
+	return true;
+}
+
+// drain, or the cycles type 0 charges for a syscall (0 for
+// functional-equivalence runs)
+bool parse_syscall_cost(const char* arg, PipelineConfig& config)
+{
+	config.syscall_drain = strcmp(arg, "drain") == 0;
+	if (config.syscall_drain)
+		return true;
+	char* end = nullptr;
+	config.syscall_cycles = strtoul(arg, &end, 10);
+	return end != arg && *end == '\0';
+}
+
+// <width>[:<block bytes>[:<FTQ entries>[:<fetch buffer entries>]]]
+bool parse_front_end(const char* arg, FrontEndConfig& config)
+{
+	char* end = nullptr;
+	config.fetch_width = strtoul(arg, &end, 10);
+	if (*end == ':')
+		config.block_size = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.ftq_size = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		config.buffer_size = strtoul(end + 1, &end, 10);
+	return *end == '\0' && config.fetch_width != 0 && config.ftq_size != 0 && config.buffer_size != 0
+		&& config.block_size >= WORD_SIZE && (config.block_size & (config.block_size - 1)) == 0;
+}
+
 int main(int argc, char* argv[])
 {
+	uint32_t heap_size = REMAIN_SIZE;
+	uint32_t stack_size = STACK_SIZE;
+
+	CacheConfig l1i{ L1I_SIZE, L1I_ASSOC, LINE_SIZE, Replacement::LRU, L1I_HIT_CYCLE };
+	CacheConfig l1d{ L1D_SIZE, L1D_ASSOC, LINE_SIZE, Replacement::LRU, L1D_HIT_CYCLE };
+	CacheConfig l2{ L2_SIZE, L2_ASSOC, LINE_SIZE, Replacement::LRU, L2_HIT_CYCLE };
+	uint32_t memory_latency = MEMORY_CYCLE;
+	uint32_t n_mshrs = L1D_MSHRS;
+	const char* prefetch = nullptr;
+	PredictorConfig bp;
+	uint32_t btb_entries = BTB_ENTRIES;
+	uint32_t ras_entries = RAS_ENTRIES;
+	FrontEndConfig front_end;
+	uint32_t rob_size = ROB_SIZE;
+	SchedulerConfig sched;
+	CoreConfig core;
+	RenameConfig prf;
+	StoreSetConfig ssit;
+	PipelineConfig in_order;
+	bool jit = true;
+
+	// leading --heap=, --stack=, --l1i=, --l1d=, --l2=, --mem=, --mshr=, --prefetch=, --bp=, --btb=, --ras=, --fetch=, --width=, --rob=, --rs=, --fu=, --prf=, --ssit=, --unit=, --forward=, --syscall=, --jit= and --ecall-trace= options
+	int opt = 1;
+	for (; opt < argc && strncmp(argv[opt], "--", 2) == 0; ++opt) {
+		bool ok = false;
+		if (strncmp(argv[opt], "--heap=", 7) == 0)
+			ok = parse_size(argv[opt] + 7, heap_size);
+		else if (strncmp(argv[opt], "--stack=", 8) == 0)
+			ok = parse_size(argv[opt] + 8, stack_size);
+		else if (strncmp(argv[opt], "--l1i=", 6) == 0)
+			ok = parse_cache(argv[opt] + 6, l1i);
+		else if (strncmp(argv[opt], "--l1d=", 6) == 0)
+			ok = parse_cache(argv[opt] + 6, l1d);
+		else if (strncmp(argv[opt], "--l2=", 5) == 0)
+			ok = parse_cache(argv[opt] + 5, l2);
+		else if (strncmp(argv[opt], "--mem=", 6) == 0) {
+			char* end = nullptr;
+			memory_latency = strtoul(argv[opt] + 6, &end, 10);
+			ok = *end == '\0';
+		}
+		else if (strncmp(argv[opt], "--mshr=", 7) == 0) {
+			char* end = nullptr;
+			n_mshrs = strtoul(argv[opt] + 7, &end, 10);
+			ok = *end == '\0' && n_mshrs != 0;
+		}
+		else if (strncmp(argv[opt], "--prefetch=", 11) == 0) {
+			prefetch = argv[opt] + 11;
+			ok = true;
+		}
+		else if (strncmp(argv[opt], "--bp=", 5) == 0)
+			ok = parse_predictor(argv[opt] + 5, bp);
+		else if (strncmp(argv[opt], "--prf=", 6) == 0)
+			ok = parse_rename(argv[opt] + 6, prf);
+		else if (strncmp(argv[opt], "--rs=", 5) == 0)
+			ok = parse_scheduler(argv[opt] + 5, sched);
+		else if (strncmp(argv[opt], "--ssit=", 7) == 0)
+			ok = parse_store_sets(argv[opt] + 7, ssit);
+		else if (strncmp(argv[opt], "--fu=", 5) == 0)
+			ok = parse_units(argv[opt] + 5, sched);
+		else if (strncmp(argv[opt], "--unit=", 7) == 0)
+			ok = parse_unit_timing(argv[opt] + 7, in_order);
+		else if (strncmp(argv[opt], "--forward=", 10) == 0)
+			ok = parse_bypass(argv[opt] + 10, in_order);
+		else if (strncmp(argv[opt], "--syscall=", 10) == 0)
+			ok = parse_syscall_cost(argv[opt] + 10, in_order);
+		else if (strcmp(argv[opt], "--jit=on") == 0 || strcmp(argv[opt], "--jit=off") == 0) {
+			jit = strcmp(argv[opt], "--jit=on") == 0;
+			ok = true;
+		}
+		else if (strncmp(argv[opt], "--ecall-trace=", 14) == 0)
+			ok = trace_syscalls(argv[opt] + 14);
+		else if (strncmp(argv[opt], "--width=", 8) == 0)
+			ok = parse_core(argv[opt] + 8, core);
+		else if (strncmp(argv[opt], "--rob=", 6) == 0) {
+			char* end = nullptr;
+			rob_size = strtoul(argv[opt] + 6, &end, 10);
+			ok = *end == '\0' && rob_size != 0;
+		}
+		else if (strncmp(argv[opt], "--fetch=", 8) == 0)
+			ok = parse_front_end(argv[opt] + 8, front_end);
+		else if (strncmp(argv[opt], "--btb=", 6) == 0) {
+			char* end = nullptr;
+			btb_entries = strtoul(argv[opt] + 6, &end, 10);
+			ok = *end == '\0';
+		}
+		else if (strncmp(argv[opt], "--ras=", 6) == 0) {
+			char* end = nullptr;
+			ras_entries = strtoul(argv[opt] + 6, &end, 10);
+			ok = *end == '\0';
+		}
+		if (!ok) {
+			clog << "invalid option " << argv[opt] << endl;
+			return 1;
+		}
+	}
+	argc -= opt - 1;
+	argv += opt - 1;
+
 	uint32_t entry_point;
 	uint32_t base_vaddr;
 	uint32_t max_vaddr;
 	uint32_t sp;
+	uint32_t text_base;
+	uint32_t text_end;
 
 
 	//load_elf(argv[1], entry_point, base_vaddr, max_vaddr, memory, stack, sp);
 	//load_elf("hello-riscv-dbg", entry_point, base_vaddr, max_vaddr, memory
 	//	, stack, sp);
 	load_elf(argv[2], entry_point, base_vaddr, max_vaddr, memory
-		, stack, sp);
+		, stack, sp, text_base, text_end, heap_size, stack_size);
 
 	if (!memory) {
 		clog << "memory empty!!!" << endl;
@@ -31,47 +398,114 @@ int main(int argc, char* argv[])
 	
 	std::clog << "entry point : " << entry_point << std::endl;
 
-	Memory mem{ entry_point, base_vaddr, max_vaddr, memory, stack };
+	Memory mem{ entry_point, base_vaddr, max_vaddr, memory, stack, stack_size };
+	mem.set_text(text_base, text_end);
+
+	// fast-forward functionally, then hand the architectural state
+	// over to the timing model
+	ISS iss{ &mem, entry_point, sp, jit };
+	if (argc > 3) {
+		SwitchPoint point;
+		if (!parse_switch_point(argv[2], argv[3], point)) {
+			clog << "invalid switch point " << argv[3] << endl;
+			return 1;
+		}
+		iss.run_until(point);
+	}
+	const RegisterFile& state = iss.get_register_file();
+
+	CacheHierarchy caches{ l1i, l1d, l2, memory_latency, n_mshrs };
+
+	// comma separated list of next, stride and stream
+	for (const char* p = prefetch; p && *p; ) {
+		const char* comma = strchr(p, ',');
+		string name = comma ? string(p, comma) : string(p);
+		Prefetcher* pf = make_prefetcher(name.c_str(), caches.line_size());
+		if (!pf || !caches.add_prefetcher(pf)) {
+			clog << "invalid prefetcher " << name << endl;
+			delete pf;
+			return 1;
+		}
+		p = comma ? comma + 1 : "";
+	}
+	if (*argv[1] != '4')
+		add_exit_report([&caches]() { caches.report(clog); });
     
+	// explicit renaming for types 1-3
+	RenameMap* rename = nullptr;
+	if (prf.registers && *argv[1] >= '1' && *argv[1] <= '3') {
+		rename = new RenameMap(prf);
+		add_exit_report([rename]() { rename->report(clog); });
+	}
+	StoreSets* store_sets = nullptr;
+	if (ssit.ssit_entries && *argv[1] >= '1' && *argv[1] <= '3') {
+		store_sets = new StoreSets(ssit);
+		add_exit_report([store_sets]() { store_sets->report(clog); });
+	}
+
     // 0: in-order 5-stage
-    // 1: tomasulo
-    // 2: tomasulo + 2way
-    // 3: tomasulo + 2way + 2bit
+    // 1: tomasulo, one instruction wide
+    // 2: tomasulo + N-way (--fetch, --width)
+    // 3: tomasulo + N-way + branch predictor (--bp)
+    // 4: functional only
     switch(*argv[1]){
         case '0':{ 
-                    Pipeline pipeline{ &mem, entry_point, sp };
+                    Pipeline pipeline{ &mem, &caches, state, in_order };
+                    add_exit_report([&pipeline]() { pipeline.report(clog); });
                     pipeline.run();
                     break;
                }
         case '1':{
-                    Tomasulo pipeline{ &mem, entry_point, sp };
+                    FrontEndConfig narrow = front_end;
+                    narrow.fetch_width = 1;
+                    CoreConfig scalar = core;
+                    scalar.issue_width = 1;
+                    Tomasulo pipeline{ &mem, &caches, state, nullptr, nullptr, narrow, scalar, rob_size, sched, rename, store_sets };
+                    add_exit_report([&pipeline]() { pipeline.report(clog); });
                     pipeline.run();
                    break;
                }
         case '2':{
-                    Tomasulo_Two pipeline{ &mem, entry_point, sp };
+                    Tomasulo pipeline{ &mem, &caches, state, nullptr, nullptr, front_end, core, rob_size, sched, rename, store_sets };
+                    add_exit_report([&pipeline]() { pipeline.report(clog); });
                     pipeline.run();
                     break;
                }
         case '3':{
-                    Tomasulo_Two pipeline{ &mem, entry_point, sp, true };
+                    // a branch is predicted when its fetch block enters the FTQ
+                    bp.in_flight = rob_size + front_end.buffer_size
+                        + front_end.ftq_size * (front_end.block_size / WORD_SIZE);
+                    BranchPredictor* predictor = make_predictor(bp);
+                    TargetPredictor targets{ btb_entries, ras_entries };
+                    add_exit_report([predictor, &targets]() {
+                        predictor->report(clog);
+                        targets.report(clog);
+                    });
+                    Tomasulo pipeline{ &mem, &caches, state, predictor, &targets, front_end, core, rob_size, sched, rename, store_sets };
+                    add_exit_report([&pipeline]() { pipeline.report(clog); });
                     pipeline.run();
+                    delete predictor;
+                    break;
+               }
+        case '4':{
+                    iss.run();
                     break;
                }
         default:{
-                    Pipeline pipeline{ &mem, entry_point, sp };
+                    Pipeline pipeline{ &mem, &caches, state, in_order };
                     pipeline.run();
                     break;
                 }
     }
+	delete rename;
+	delete store_sets;
 	//Pipeline pipeline{ &mem, entry_point, sp };
 	//Tomasulo pipeline{ &mem, entry_point, sp };
-	//Tomasulo_Two pipeline{ &mem, entry_point, sp, true };
     //pipeline.run();
 		 
 
 	if (memory)
-		delete memory;
+		release_pages(memory, max_vaddr - base_vaddr + 1);
 	if (stack)
-		delete stack;
+		release_pages(stack, stack_size);
 }
@@ -1,192 +1,127 @@
 #include "memory.h"
 #include <string.h>
 #include <iostream>
+#include <sys/mman.h>
 
-int32_t Memory::read_int(uint32_t vaddr, uint8_t size, bool sigend)
+char* reserve_pages(size_t size)
 {
-	if (base_vaddr <= vaddr && vaddr <= max_vaddr) {
-		switch (size)
-		{
-		case BYTE_SIZE: {
-			int8_t b;
-			memcpy(&b, &memory[vaddr - base_vaddr], BYTE_SIZE);
-			if (sigend)
-				return b;
-			else
-				return uint8_t(b);
-		}
-		case HALFWORD_SIZE: {
-			int16_t h;
-			memcpy(&h, &memory[vaddr - base_vaddr], HALFWORD_SIZE);
-			if (sigend)
-				return h;
-			else
-				return uint16_t(h);
-		}
-		case WORD_SIZE: {
-			int32_t w;
-			memcpy(&w, &memory[vaddr - base_vaddr], WORD_SIZE);
-			if (sigend)
-				return w;
-			else
-				return uint32_t(w);
-		}
-		}
+	void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE
+		, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED) {
+		std::clog << "cannot reserve " << std::dec << size << " bytes" << std::endl;
+		exit(1);
 	}
-	else if ((0xffffffff - STACK_SIZE) <= vaddr && vaddr <= 0xffffffff) {
-		switch (size)
-		{
-		case BYTE_SIZE: {
-			int8_t b;
-			memcpy(&b
-				, &stack[vaddr - STACK_OFFSET], BYTE_SIZE);
-			if (sigend)
-				return b;
-			else
-				return uint8_t(b);
-		}
-		case HALFWORD_SIZE: {
-			int16_t h;
-			memcpy(&h
-				, &stack[vaddr - STACK_OFFSET], HALFWORD_SIZE);
-			if (sigend)
-				return h;
-			else
-				return uint16_t(h);
-		}
-		case WORD_SIZE: {
-			int32_t w;
-			memcpy(&w
-				, &stack[vaddr - STACK_OFFSET], WORD_SIZE);
-			if (sigend)
-				return w;
-			else
-				return uint32_t(w);
-		}
+	return (char*)p;
+}
+
+void release_pages(char* p, size_t size)
+{
+	munmap(p, size);
+}
+
+void Memory::map(uint32_t vaddr, uint32_t size, char* host)
+{
+	for (uint32_t off = 0; off < size; off += PAGE_SIZE)
+		pages[(vaddr + off) >> PAGE_SHIFT] = host + off;
+}
+
+uint64_t Memory::checksum() const
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (uint32_t vpn = 0; vpn < PAGE_COUNT; ++vpn) {
+		const char* page = pages[vpn];
+		if (!page)
+			continue;
+		hash = (hash ^ vpn) * 0x100000001b3ull;
+		for (uint32_t off = 0; off < PAGE_SIZE; off += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, page + off, sizeof(word));
+			hash = (hash ^ word) * 0x100000001b3ull;
 		}
 	}
-	else if (0 <= vaddr && vaddr <= TLS_SIZE) {
-		switch (size)
-		{
-		case BYTE_SIZE: {
-			int8_t b;
-			memcpy(&b
-				, &tls[vaddr], BYTE_SIZE);
-			if (sigend)
-				return b;
-			else
-				return uint8_t(b);
-		}
-		case HALFWORD_SIZE: {
-			int16_t h;
-			memcpy(&h
-				, &tls[vaddr], HALFWORD_SIZE);
-			if (sigend)
-				return h;
-			else
-				return uint16_t(h);
-		}
-		case WORD_SIZE: {
-			int32_t w;
-			memcpy(&w
-				, &tls[vaddr], WORD_SIZE);
-			if (sigend)
-				return w;
-			else
-				return uint32_t(w);
-		}
-		}
+	return hash;
+}
 
-	}
-	
+void Memory::fault(uint32_t vaddr)
+{
 	std::clog << "invalid memory access [" << std::hex << vaddr << "]" << std::endl;
 	exit(1);
-	return 0;
 }
 
-float Memory::read_float(uint32_t vaddr)
+int32_t Memory::read_int(uint32_t vaddr, uint8_t size, bool sigend)
 {
-	
-	if (base_vaddr <= vaddr && vaddr <= max_vaddr) {
-		float f;
-		memcpy(&f, &memory[vaddr - base_vaddr], WORD_SIZE);
-	
-		return f;
+	char* p = translate(vaddr);
+
+	switch (size)
+	{
+	case BYTE_SIZE: {
+		int8_t b;
+		memcpy(&b, p, BYTE_SIZE);
+		if (sigend)
+			return b;
+		else
+			return uint8_t(b);
 	}
-	else if ((0xffffffff - STACK_SIZE) <= vaddr && vaddr <= 0xffffffff) {
-		float f;
-		memcpy(&f
-			, &stack[vaddr - STACK_OFFSET], WORD_SIZE);
-
-		return f;
-		
+	case HALFWORD_SIZE: {
+		int16_t h;
+		memcpy(&h, p, HALFWORD_SIZE);
+		if (sigend)
+			return h;
+		else
+			return uint16_t(h);
+	}
+	case WORD_SIZE: {
+		int32_t w;
+		memcpy(&w, p, WORD_SIZE);
+		return w;
 	}
-	else if (0 <= vaddr && vaddr <= TLS_SIZE) {
-		float f;
-		memcpy(&f
-			, &tls[vaddr], WORD_SIZE);
-
-		return f;
-
 	}
 
-	std::clog << "invalid memory access [" << std::hex<< vaddr << "]" << std::endl;
-	exit(1);
-	return 0.0f;
+	fault(vaddr);
+	return 0;
+}
+
+float Memory::read_float(uint32_t vaddr)
+{
+	float f;
+	memcpy(&f, translate(vaddr), WORD_SIZE);
+	return f;
 }
 
 void Memory::write(uint32_t vaddr, uint8_t size, uint32_t* data)
 {
-	if (base_vaddr <= vaddr && vaddr <= max_vaddr) {
-		if(size == BYTE_SIZE || size == HALFWORD_SIZE)
-            memcpy(&memory[vaddr - base_vaddr]
-			    , (const void*)(data), size);
-		else 
-            memcpy(&memory[vaddr - base_vaddr]
-			    , (const void*)(data), size);
-
-        return;
-	}
-	else if ((0xffffffff - STACK_SIZE) <= vaddr && vaddr <= 0xffffffff) {
-		if(size == BYTE_SIZE || size == HALFWORD_SIZE)
-		    memcpy(&stack[vaddr - STACK_OFFSET]
-			    , (const void*)(data), size);
-		else
-		    memcpy(&stack[vaddr - STACK_OFFSET]
-			    , (const void*)(data), size);
+	if (decode_cache)
+		decode_cache->invalidate(vaddr, size);
 
-        return;
+	memcpy(translate(vaddr), (const void*)(data), size);
+}
 
-	}
-	else if (0 <= vaddr && vaddr <= TLS_SIZE) {
-		if(size == BYTE_SIZE || size == HALFWORD_SIZE)
-		    memcpy(&tls[vaddr]
-			    , (const void*)(data), size);
-		else
-		    memcpy(&tls[vaddr]
-			    , (const void*)(data), size);
-        return;
+char* Memory::get_ptr(uint32_t vaddr)
+{
+	return translate(vaddr);
+}
 
-	}
+char* Memory::get_writable_ptr(uint32_t vaddr, uint32_t size)
+{
+	if (decode_cache)
+		decode_cache->invalidate(vaddr, size);
 
-	std::clog << "invalid memory access [" << std::hex << vaddr << "]" << std::endl;
-	exit(1);
+	return translate(vaddr);
 }
 
-char* Memory::get_ptr(uint32_t vaddr)
+Instruction Memory::fetch_insn(uint32_t pc)
 {
-	if (base_vaddr <= vaddr && vaddr <= max_vaddr) {
-		return &memory[vaddr - base_vaddr];
-	}
-	else if ((0xffffffff - STACK_SIZE) <= vaddr && vaddr <= 0xffffffff) {
-		return &stack[vaddr - STACK_OFFSET];
-	}
-	else if (0 <= vaddr && vaddr <= TLS_SIZE) {
-		return &tls[vaddr];
-	}
+	if (decode_cache)
+		return decode_cache->lookup(pc);
 
-	std::clog << "invalid memory access [" << std::hex << vaddr << "]" << std::endl;
-	exit(1);
-	return 0;
+	Instruction insn{ uint32_t(read_int(pc, WORD_SIZE)) };
+	insn.fields.pc = pc;
+	insn.decode();
+	return insn;
 }
 
+void Memory::flush_decode_cache()
+{
+	if (decode_cache)
+		decode_cache->flush();
+}
@@ -1,6 +1,13 @@
 #pragma once
 #include <stdint.h>
 #include "consts.h"
+#include "instruction.h"
+#include "decode_cache.h"
+#include <stddef.h>
+
+// zero-filled host memory that is only backed once touched
+char* reserve_pages(size_t size);
+void release_pages(char* p, size_t size);
 
 class Memory {
 	uint32_t entry_point;
@@ -11,19 +18,74 @@ class Memory {
 	char* stack{ nullptr };
 	char* tls{ nullptr };
 
+	DecodeCache* decode_cache{ nullptr };
+
+	// guest page number -> host page, nullptr when unmapped
+	char** pages{ nullptr };
+
+	// last translations, indexed by the low bits of the page number
+	uint32_t hit_vpn[TLB_ENTRIES];
+	char* hit_page[TLB_ENTRIES];
+
+private:
+	void map(uint32_t vaddr, uint32_t size, char* host);
+	void fault(uint32_t vaddr);
+
+	char* translate(uint32_t vaddr) {
+		uint32_t vpn = vaddr >> PAGE_SHIFT;
+		uint32_t slot = vpn & (TLB_ENTRIES - 1);
+		if (hit_vpn[slot] != vpn) {
+			char* page = pages[vpn];
+			if (!page) fault(vaddr);
+			hit_vpn[slot] = vpn;
+			hit_page[slot] = page;
+		}
+		return hit_page[slot] + (vaddr & PAGE_MASK);
+	}
 
 public:
-	Memory(uint32_t entry, uint32_t base, uint32_t max, char* mem, char* stk) :
+	Memory(uint32_t entry, uint32_t base, uint32_t max, char* mem, char* stk, uint32_t stack_size) :
 		entry_point(entry), base_vaddr(base), max_vaddr(max), memory(mem), stack(stk)
 	{
-		tls = new char[TLS_SIZE]();
+		tls = reserve_pages(TLS_SIZE + 1);
+
+		pages = (char**)reserve_pages(PAGE_COUNT * sizeof(char*));
+		for (int i = 0; i < TLB_ENTRIES; ++i)
+			hit_vpn[i] = 0xffffffff;
+
+		// later mappings win: the image over the stack over the TLS
+		map(0, TLS_SIZE + 1, tls);
+		map(0 - stack_size, stack_size, stack);
+		map(base_vaddr, max_vaddr - base_vaddr + 1, memory);
 	}
 	~Memory() {
-		if (tls) delete tls;
+		if (tls) release_pages(tls, TLS_SIZE + 1);
+		if (pages) release_pages((char*)pages, PAGE_COUNT * sizeof(char*));
+		if (decode_cache) delete decode_cache;
+	}
+
+	void set_text(uint32_t text_base, uint32_t text_end) {
+		if (decode_cache) delete decode_cache;
+		decode_cache = new DecodeCache(this, text_base, text_end);
 	}
 
 	int32_t read_int(uint32_t vaddr, uint8_t size, bool sigend = true);
 	float read_float(uint32_t vaddr);
 	void write(uint32_t vaddr, uint8_t size, uint32_t* data);
 	char* get_ptr(uint32_t vaddr);
+	// for a host call that writes size bytes, drops the text it overwrites
+	char* get_writable_ptr(uint32_t vaddr, uint32_t size);
+
+	// FNV-1a over every mapped page, for comparing guest state
+	uint64_t checksum() const;
+
+	Instruction fetch_insn(uint32_t pc);
+	void flush_decode_cache();
+
+	bool in_text(uint32_t pc) const {
+		return decode_cache && decode_cache->covers(pc);
+	}
+	uint32_t text_generation() const {
+		return decode_cache ? decode_cache->get_generation() : 0;
+	}
 };
@@ -1,13 +1,18 @@
 #include "pipeline.h"
+#include "rv32m.h"
 #include "syscall.h"
 #include <stdio.h>
 #include <string>
 #include <iostream>
+#include <algorithm>
 
 void Pipeline::fetch_first_half()
 {
 	iF.cond = false;
 	iF.syscall_invalidation = false;
+	if (syscall_busy > 0)
+		--syscall_busy;
+	iF.ready = fetch_port.ready(caches, uint32_t(register_file.pc));
 	iF.raw_insn = memory->read_int(uint32_t(register_file.pc), WORD_SIZE);
 }
 
@@ -18,13 +23,21 @@ Stage_Result Pipeline::fetch_second_half()
 	}
 
 	if (iF.cond) {
+		++stalls[int(Hazard::CONTROL)];
 		register_file.pc = iF.target_addr;
 		return Stage_Result::BRANCH_STALL;
 	}
 
+	if (syscall_busy > 0)
+		return Stage_Result::SYSCALL_STALL;
+
+	if (!iF.ready)
+		return Stage_Result::ICACHE_STALL;
+
 	if (if_id.raw_insn == 0) {
 		if_id.pc = register_file.pc;
 		if_id.raw_insn = iF.raw_insn;
+		fetch_port.consume();
 
 		register_file.pc += WORD_SIZE;
 
@@ -39,19 +52,27 @@ void Pipeline::id_first_half()
 {
 	id.cond = false;
 	id.syscall_invalidation = false;
-	id.insn = Instruction{ if_id.raw_insn };
-	id.insn.fields.pc = if_id.pc;
-	id.insn.decode();
+	if (if_id.raw_insn == 0)
+		id.insn = Instruction{ 0 };
+	else
+		id.insn = memory->fetch_insn(if_id.pc);
 }
 
 bool Pipeline::is_syscall_sync_insn()
 {
-	if (id_ex_fpadd.insn.value != 0
+	// older multiply/divide and FP results reach WB before the ECALL once
+	// they have left their unit, so the syscall sees precise registers;
+	// older ALU ops and loads are ahead of it in its own pipe
+	if (id_ex_muldiv.insn.value != 0
+		|| id_ex_fpadd.insn.value != 0
 		|| id_ex_fpmul.insn.value != 0
 		|| id_ex_fpdiv.insn.value != 0)
 		return true;
+	if (!mul_unit.empty() || !div_unit.empty() || !fpadd_unit.empty()
+		|| !fpmul_unit.empty() || !fpdiv_unit.empty())
+		return true;
 
-	if (ex_mem_alu.insn.value != 0
+	if (config.syscall_drain && ex_mem_alu.insn.value != 0
 		&& (ex_mem_alu.insn.opcode == Opcode::LOAD
 			|| ex_mem_alu.insn.opcode == Opcode::LOAD_FP
 			|| ex_mem_alu.insn.opcode == Opcode::STORE
@@ -62,41 +83,111 @@ bool Pipeline::is_syscall_sync_insn()
 	return false;
 }
 
+bool Pipeline::syscall_in_flight() const
+{
+	return (id_ex_alu.insn.value != 0 && id_ex_alu.insn.function == Function::ECALL)
+		|| (ex_mem_alu.insn.value != 0 && ex_mem_alu.insn.function == Function::ECALL)
+		|| (mem_wb_alu.insn.value != 0 && mem_wb_alu.insn.function == Function::ECALL);
+}
+
+bool Pipeline::bypass(Bypass path, UNIT unit)
+{
+	if (config.bypass[int(path)] & (1u << int(unit))) {
+		++bypassed[int(path)];
+		return false;
+	}
+	hazard = Hazard(int(Hazard::RAW_EX_EX) + int(path));
+	return true;
+}
+
 bool Pipeline::check_gpr_dependency(uint32_t rs)
 {
 	if (rs == 0) return false;
+	hazard = Hazard::RAW_EXECUTE;
 	if (id_ex_alu.insn.value != 0 && id_ex_alu.insn.fields.rd == rs)
 		return true;
-	if (ex_mem_alu.insn.value != 0 
-		&& (ex_mem_alu.insn.opcode == Opcode::LOAD || ex_mem_alu.insn.opcode == Opcode::AMO)
-		&& ex_mem_alu.insn.fields.rd == rs)
-		return true;		
+	if (id_ex_muldiv.insn.value != 0 && id_ex_muldiv.insn.fields.rd == rs)
+		return true;
+	if (mul_unit.writes(rs) || div_unit.writes(rs))
+		return true;
     if (rs == 10 && id_ex_alu.insn.value != 0 && id_ex_alu.insn.opcode == Opcode::SYSTEM)
         return true;
     if (rs == 10 && ex_mem_alu.insn.value != 0 && ex_mem_alu.insn.opcode == Opcode::SYSTEM)
         return true;
     if (rs == 10 && mem_wb_alu.insn.value != 0 && mem_wb_alu.insn.opcode == Opcode::SYSTEM)
         return true;
+	hazard = Hazard::RAW_LOAD;
+	if (ex_mem_alu.insn.value != 0 
+		&& (ex_mem_alu.insn.opcode == Opcode::LOAD || ex_mem_alu.insn.opcode == Opcode::AMO)
+		&& ex_mem_alu.insn.fields.rd == rs)
+		return true;		
+
+	// the youngest producer in flight decides the bypass
+	if (ex_mem_alu.insn.value != 0
+		&& ex_mem_alu.insn.opcode != Opcode::LOAD_FP
+		&& ex_mem_alu.insn.fields.rd == rs)
+		return bypass(Bypass::EX_EX, UNIT::ALU);
+	if (ex_mem_muldiv.insn.value != 0 && ex_mem_muldiv.insn.fields.rd == rs)
+		return bypass(Bypass::EX_EX, UNIT::MULDIV);
+	if (mem_wb_alu.insn.value != 0
+		&& mem_wb_alu.insn.opcode != Opcode::LOAD_FP
+		&& mem_wb_alu.insn.fields.rd == rs)
+		return bypass(Bypass::MEM_EX, UNIT::ALU);
+	if (mem_wb_muldiv.insn.value != 0 && mem_wb_muldiv.insn.fields.rd == rs)
+		return bypass(Bypass::MEM_EX, UNIT::MULDIV);
+	if (written_back[int(UNIT::ALU)] & (uint64_t(1) << rs))
+		return bypass(Bypass::WB_ID, UNIT::ALU);
+	if (written_back[int(UNIT::MULDIV)] & (uint64_t(1) << rs))
+		return bypass(Bypass::WB_ID, UNIT::MULDIV);
 
 	return false;
 }
 
 bool Pipeline::check_fpr_dependency(uint32_t rs)
 {
+	hazard = Hazard::RAW_EXECUTE;
 	if (id_ex_fpadd.insn.value != 0 && id_ex_fpadd.insn.fields.rd == rs) return true;
 	if (id_ex_fpmul.insn.value != 0 && id_ex_fpmul.insn.fields.rd == rs) return true;
 	if (id_ex_fpdiv.insn.value != 0 && id_ex_fpdiv.insn.fields.rd == rs) return true;
+	if (fpadd_unit.writes(rs) || fpmul_unit.writes(rs) || fpdiv_unit.writes(rs)) return true;
+	if (id_ex_alu.insn.value != 0
+		&& id_ex_alu.insn.opcode == Opcode::LOAD_FP
+		&& id_ex_alu.insn.fields.rd == rs)
+		return true;
+	hazard = Hazard::RAW_LOAD;
 	if (ex_mem_alu.insn.value != 0
 		&& (ex_mem_alu.insn.opcode == Opcode::LOAD_FP)
 		&& ex_mem_alu.insn.fields.rd == rs)
 		return true;
 
+	if (ex_mem_fpadd.insn.value != 0 && ex_mem_fpadd.insn.fields.rd == rs)
+		return bypass(Bypass::EX_EX, UNIT::FADD);
+	if (ex_mem_fpmul.insn.value != 0 && ex_mem_fpmul.insn.fields.rd == rs)
+		return bypass(Bypass::EX_EX, UNIT::FMUL);
+	if (ex_mem_fpdiv.insn.value != 0 && ex_mem_fpdiv.insn.fields.rd == rs)
+		return bypass(Bypass::EX_EX, UNIT::FDIV);
+	if (mem_wb_fpadd.insn.value != 0 && mem_wb_fpadd.insn.fields.rd == rs)
+		return bypass(Bypass::MEM_EX, UNIT::FADD);
+	if (mem_wb_fpmul.insn.value != 0 && mem_wb_fpmul.insn.fields.rd == rs)
+		return bypass(Bypass::MEM_EX, UNIT::FMUL);
+	if (mem_wb_fpdiv.insn.value != 0 && mem_wb_fpdiv.insn.fields.rd == rs)
+		return bypass(Bypass::MEM_EX, UNIT::FDIV);
+	if (mem_wb_alu.insn.value != 0
+		&& mem_wb_alu.insn.opcode == Opcode::LOAD_FP
+		&& mem_wb_alu.insn.fields.rd == rs)
+		return bypass(Bypass::MEM_EX, UNIT::ALU);
+	for (UNIT unit : { UNIT::ALU, UNIT::FADD, UNIT::FMUL, UNIT::FDIV }) {
+		if (written_back[int(unit)] & (uint64_t(1) << (32 + rs)))
+			return bypass(Bypass::WB_ID, unit);
+	}
+
 	return false;
 }
 
 
 bool Pipeline::check_raw_hazard()
 {
+	std::fill(bypassed, bypassed + BYPASS_PATHS, 0);
 	switch (id.insn.opcode)
 	{
 	case Opcode::LUI: return false;
@@ -144,6 +235,12 @@ bool Pipeline::check_fpr_waw_hazard(uint32_t rd)
 	if (id_ex_fpdiv.insn.value != 0
 		&& id_ex_fpdiv.insn.fields.rd == rd)
 		return true;
+	if (fpadd_unit.writes(rd) || fpmul_unit.writes(rd) || fpdiv_unit.writes(rd))
+		return true;
+	if (id_ex_alu.insn.value != 0
+		&& id_ex_alu.insn.opcode == Opcode::LOAD_FP
+		&& id_ex_alu.insn.fields.rd == rd)
+		return true;
 	if (ex_mem_alu.insn.value != 0
 		&& ex_mem_alu.insn.opcode == Opcode::LOAD_FP 
 		&& ex_mem_alu.insn.fields.rd == rd)
@@ -158,6 +255,11 @@ bool Pipeline::check_gpr_waw_hazard(uint32_t rd)
 	if (id_ex_alu.insn.value != 0
 		&& id_ex_alu.insn.fields.rd == rd)
 		return true;
+	if (id_ex_muldiv.insn.value != 0
+		&& id_ex_muldiv.insn.fields.rd == rd)
+		return true;
+	if (mul_unit.writes(rd) || div_unit.writes(rd))
+		return true;
 	if (ex_mem_alu.insn.value != 0
 		&& (ex_mem_alu.insn.opcode == Opcode::LOAD || ex_mem_alu.insn.opcode == Opcode::AMO)
 		&& ex_mem_alu.insn.fields.rd == rd)
@@ -302,13 +404,21 @@ Stage_Result Pipeline::id_second_half()
 	}
 
 	if(id.cond){
+		++stalls[int(Hazard::CONTROL)];
 		if_id.raw_insn = 0;
 		return Stage_Result::BRANCH_STALL;
 	}
 
+	if (syscall_busy > 0) {
+		++stalls[int(Hazard::SYSCALL)];
+		return Stage_Result::SYSCALL_STALL;
+	}
+
 	if (id.insn.function == Function::ECALL) {
-		if (is_syscall_sync_insn())
+		if (is_syscall_sync_insn()) {
+			++stalls[int(Hazard::SYSCALL_DRAIN)];
 			return Stage_Result::SYSCALL_SYNC_STALL;
+		}
 	}
 
 	bool writable = false;
@@ -347,15 +457,28 @@ Stage_Result Pipeline::id_second_half()
 	}
 
 	if (writable) {
-		if (check_raw_hazard())
+		// the other units could write back ahead of an ECALL stuck behind
+		// a load, so nothing younger enters them until it has
+		if (unit != UNIT::ALU && syscall_in_flight()) {
+			++stalls[int(Hazard::SYSCALL_DRAIN)];
+			return Stage_Result::SYSCALL_SYNC_STALL;
+		}
+		if (check_raw_hazard()) {
+			++stalls[int(hazard)];
 			return Stage_Result::RAW;
-		if (check_waw_hazard())
+		}
+		if (check_waw_hazard()) {
+			++stalls[int(Hazard::WAW)];
 			return Stage_Result::WAW;
+		}
+		for (int path = 0; path < BYPASS_PATHS; ++path)
+			bypass_uses[path] += bypassed[path];
 		fetch_registers(unit);
 		if_id.raw_insn = 0;
 		return Stage_Result::ID;
 	}
 	else {
+		++stalls[int(Hazard::STRUCTURAL)];
 		return Stage_Result::STRUCTURAL;
 	}
 
@@ -533,55 +656,21 @@ void Pipeline::execute_muldiv_first_half()
 	ex_muldiv.nop = false;
 	ex_muldiv.syscall_invalidation = false;
 
-	if (id_ex_muldiv.insn.value == 0) {
-		ex_muldiv.nop = true;
-		return;
-	}
-
-	switch (id_ex_muldiv.insn.function)
-	{
-	case Function::MUL: {
-		int64_t out = (id_ex_muldiv.A) * (id_ex_muldiv.B);
-		int32_t low = out & 0xFFFFFFFF;
-		ex_muldiv.aluout = low;
-		return;
-	}
-	case Function::MULH: {
-		int64_t out = int64_t(id_ex_muldiv.A) * int64_t(id_ex_muldiv.B);
-		int32_t high = (out & 0xFFFFFFFF00000000) >> 32;
-		ex_muldiv.aluout = high;
-		return;
-	}
-	case Function::MULHSU: {
-		int64_t out = int64_t(id_ex_muldiv.A) * uint64_t(id_ex_muldiv.B);
-		int32_t high = (out & 0xFFFFFFFF00000000) >> 32;
-		ex_muldiv.aluout = high;
-		return;
-	}
-	case Function::MULHU: {
-		uint64_t out = uint64_t(id_ex_muldiv.A) * uint64_t(id_ex_muldiv.B);
-		int32_t high = (out & 0xFFFFFFFF00000000) >> 32;
-		ex_muldiv.aluout = high;
-		return;
-	}
-	case Function::DIV: {
-		ex_muldiv.aluout = id_ex_muldiv.A / id_ex_muldiv.B;
-		return;
-	}
-	case Function::DIVU: {
-		ex_muldiv.aluout = uint32_t(id_ex_muldiv.A) / uint32_t(id_ex_muldiv.B);
-		return;
-	}
-	case Function::REM: {
-		ex_muldiv.aluout = id_ex_muldiv.A % id_ex_muldiv.B;
-		return;
-	}
-	case Function::REMU: {
-		ex_muldiv.aluout = uint32_t(id_ex_muldiv.A) % uint32_t(id_ex_muldiv.B);
-		return;
-	}
+	if (id_ex_muldiv.insn.value != 0) {
+		Function function = id_ex_muldiv.insn.function;
+		bool divide = rv32m_is_div(function);
+		MultiCycleUnit<int32_t>& unit = divide ? div_unit : mul_unit;
+		if (unit.accepts()) {
+			int32_t out = rv32m(function, id_ex_muldiv.A, id_ex_muldiv.B);
+			unit.start(id_ex_muldiv.insn, out, divide ? config.div : config.mul);
+			id_ex_muldiv.insn.value = 0;
+		}
 	}
+	mul_unit.tick();
+	div_unit.tick();
 
+	if (id_ex_muldiv.insn.value == 0 && mul_unit.empty() && div_unit.empty())
+		ex_muldiv.nop = true;
 }
 
 Stage_Result Pipeline::execute_muldiv_second_half()
@@ -591,15 +680,23 @@ Stage_Result Pipeline::execute_muldiv_second_half()
 	}
 
 	if (ex_muldiv.syscall_invalidation) {
+		mul_unit.clear();
+		div_unit.clear();
 		id_ex_muldiv.insn.value = 0;
 		return Stage_Result::SYSCALL_STALL;
 	}
 
-
-	ex_mem_muldiv.alu_result = ex_muldiv.aluout;
-	ex_mem_muldiv.insn = id_ex_muldiv.insn;
-	id_ex_muldiv.insn.value = 0;
-
+	// a multiply may finish before an older divide; the WAW check keeps
+	// them from writing the same register. On a tie the divider goes first
+	if (ex_mem_muldiv.insn.value == 0) {
+		MultiCycleUnit<int32_t>* unit = div_unit.done() ? &div_unit
+			: (mul_unit.done() ? &mul_unit : nullptr);
+		if (unit) {
+			ex_mem_muldiv.alu_result = unit->result();
+			ex_mem_muldiv.insn = unit->insn();
+			unit->pop();
+		}
+	}
 
 	return Stage_Result::MULDIV;
 }
@@ -609,17 +706,19 @@ void Pipeline::execute_fpadd_first_half()
 	ex_fpadd.nop = false;
 	ex_fpadd.syscall_invalidation = false;
 
-	if (id_ex_fpadd.insn.value == 0) {
-		ex_fpadd.nop = true;
-		return;
-	}
-	
-	if (++(ex_fpadd.step) >= FP_ADD_CYCLE) {
+	if (id_ex_fpadd.insn.value != 0 && fpadd_unit.accepts()) {
+		float out;
 		if (id_ex_fpadd.insn.function == Function::FADD_S)
-			ex_fpadd.fpuout = id_ex_fpadd.A + id_ex_fpadd.B;
+			out = id_ex_fpadd.A + id_ex_fpadd.B;
 		else
-			ex_fpadd.fpuout = id_ex_fpadd.A - id_ex_fpadd.B;
+			out = id_ex_fpadd.A - id_ex_fpadd.B;
+		fpadd_unit.start(id_ex_fpadd.insn, out, config.fpadd);
+		id_ex_fpadd.insn.value = 0;
 	}
+	fpadd_unit.tick();
+
+	if (id_ex_fpadd.insn.value == 0 && fpadd_unit.empty())
+		ex_fpadd.nop = true;
 }
 
 Stage_Result Pipeline::execute_fpadd_second_half()
@@ -629,16 +728,15 @@ Stage_Result Pipeline::execute_fpadd_second_half()
 	}
 
 	if (ex_fpadd.syscall_invalidation) {
-		ex_fpadd.step = 0;
+		fpadd_unit.clear();
 		id_ex_fpadd.insn.value = 0;
 		return Stage_Result::SYSCALL_STALL;
 	}
 
-	if (ex_fpadd.step >= FP_ADD_CYCLE) {
-		ex_mem_fpadd.fpu_result = ex_fpadd.fpuout;
-		ex_mem_fpadd.insn = id_ex_fpadd.insn;
-		id_ex_fpadd.insn.value = 0;
-		ex_fpadd.step = 0;
+	if (fpadd_unit.done() && ex_mem_fpadd.insn.value == 0) {
+		ex_mem_fpadd.fpu_result = fpadd_unit.result();
+		ex_mem_fpadd.insn = fpadd_unit.insn();
+		fpadd_unit.pop();
 	}
 
 	return Stage_Result::FPADD;
@@ -649,14 +747,14 @@ void Pipeline::execute_fpmul_first_half()
 	ex_fpmul.nop = false;
 	ex_fpmul.syscall_invalidation = false;
 
-	if (id_ex_fpmul.insn.value == 0) {
-		ex_fpmul.nop = true;
-		return;
+	if (id_ex_fpmul.insn.value != 0 && fpmul_unit.accepts()) {
+		fpmul_unit.start(id_ex_fpmul.insn, id_ex_fpmul.A * id_ex_fpmul.B, config.fpmul);
+		id_ex_fpmul.insn.value = 0;
 	}
+	fpmul_unit.tick();
 
-	if (++(ex_fpmul.step) >= FP_MUL_CYCLE) {
-		ex_fpmul.fpuout = id_ex_fpmul.A * id_ex_fpmul.B;
-	}
+	if (id_ex_fpmul.insn.value == 0 && fpmul_unit.empty())
+		ex_fpmul.nop = true;
 }
 
 Stage_Result Pipeline::execute_fpmul_second_half()
@@ -666,16 +764,15 @@ Stage_Result Pipeline::execute_fpmul_second_half()
 	}
 
 	if (ex_fpmul.syscall_invalidation) {
-		ex_fpmul.step = 0;
+		fpmul_unit.clear();
 		id_ex_fpmul.insn.value = 0;
 		return Stage_Result::SYSCALL_STALL;
 	}
 
-	if (ex_fpmul.step >= FP_MUL_CYCLE) {
-		ex_mem_fpmul.fpu_result = ex_fpmul.fpuout;
-		ex_mem_fpmul.insn = id_ex_fpmul.insn;
-		id_ex_fpmul.insn.value = 0;
-		ex_fpmul.step = 0;
+	if (fpmul_unit.done() && ex_mem_fpmul.insn.value == 0) {
+		ex_mem_fpmul.fpu_result = fpmul_unit.result();
+		ex_mem_fpmul.insn = fpmul_unit.insn();
+		fpmul_unit.pop();
 	}
 
 	return Stage_Result::FPMUL;
@@ -685,15 +782,15 @@ void Pipeline::execute_fpdiv_first_half()
 {
 	ex_fpdiv.nop = false;
 	ex_fpdiv.syscall_invalidation = false;
-	
-	if (id_ex_fpdiv.insn.value == 0) {
-		ex_fpdiv.nop = true;
-		return;
-	}
-	
-	if (++(ex_fpdiv.step) >= FP_DIV_CYCLE) {
-		ex_fpdiv.fpuout = id_ex_fpdiv.A / id_ex_fpdiv.B;
+
+	if (id_ex_fpdiv.insn.value != 0 && fpdiv_unit.accepts()) {
+		fpdiv_unit.start(id_ex_fpdiv.insn, id_ex_fpdiv.A / id_ex_fpdiv.B, config.fpdiv);
+		id_ex_fpdiv.insn.value = 0;
 	}
+	fpdiv_unit.tick();
+
+	if (id_ex_fpdiv.insn.value == 0 && fpdiv_unit.empty())
+		ex_fpdiv.nop = true;
 }
 
 Stage_Result Pipeline::execute_fpdiv_second_half()
@@ -703,16 +800,15 @@ Stage_Result Pipeline::execute_fpdiv_second_half()
 	}
 
 	if (ex_fpdiv.syscall_invalidation) {
-		ex_fpdiv.step = 0;
+		fpdiv_unit.clear();
 		id_ex_fpdiv.insn.value = 0;
 		return Stage_Result::SYSCALL_STALL;
 	}
-	
-	if (ex_fpdiv.step >= FP_DIV_CYCLE) {
-		ex_mem_fpdiv.fpu_result = ex_fpdiv.fpuout;
-		ex_mem_fpdiv.insn = id_ex_fpdiv.insn;
-		id_ex_fpdiv.insn.value = 0;
-		ex_fpdiv.step = 0;
+
+	if (fpdiv_unit.done() && ex_mem_fpdiv.insn.value == 0) {
+		ex_mem_fpdiv.fpu_result = fpdiv_unit.result();
+		ex_mem_fpdiv.insn = fpdiv_unit.insn();
+		fpdiv_unit.pop();
 	}
 
 	return Stage_Result::FPDIV;
@@ -859,7 +955,25 @@ void Pipeline::mem_alu_first_half()
 		|| ex_mem_alu.insn.opcode == Opcode::STORE
 		|| ex_mem_alu.insn.opcode == Opcode::STORE_FP
 		|| ex_mem_alu.insn.opcode == Opcode::AMO) {
-		if (++mem_alu.step == CACHE_ACCESS_CYCLE) {
+		// the syscall in WB goes to memory before any younger access
+		if (mem_alu.step == 0 && mem_wb_alu.insn.value != 0
+			&& mem_wb_alu.insn.function == Function::ECALL)
+			return;
+		if (mem_alu.step == 0) {
+			uint32_t addr = ex_mem_alu.alu_result;
+			if (ex_mem_alu.insn.opcode == Opcode::LOAD
+				|| ex_mem_alu.insn.opcode == Opcode::LOAD_FP) {
+				// no free MSHR, retry next cycle
+				if (!caches->load(addr, mem_alu.latency))
+					return;
+			}
+			else
+				mem_alu.latency = caches->store(addr);
+			// once per access, not on every MSHR retry
+			if (ex_mem_alu.insn.opcode != Opcode::AMO)
+				caches->train(ex_mem_alu.insn.fields.pc, addr);
+		}
+		if (++mem_alu.step == mem_alu.latency) {
 			switch (ex_mem_alu.insn.opcode)
 			{
 			case Opcode::LOAD:
@@ -894,7 +1008,7 @@ Stage_Result Pipeline::mem_alu_second_half()
 		|| ex_mem_alu.insn.opcode == Opcode::STORE
 		|| ex_mem_alu.insn.opcode == Opcode::STORE_FP
 		|| ex_mem_alu.insn.opcode == Opcode::AMO) {
-		if (mem_alu.step == CACHE_ACCESS_CYCLE) {
+		if (mem_alu.step != 0 && mem_alu.step == mem_alu.latency) {
 			if (ex_mem_alu.insn.opcode != Opcode::STORE
 				&& ex_mem_alu.insn.opcode != Opcode::STORE_FP) {
 				mem_wb_alu.insn = ex_mem_alu.insn;
@@ -1039,7 +1153,9 @@ int Pipeline::wb_alu_first_half(unsigned long long clock)
 	}
 
 	uint32_t rd = mem_wb_alu.insn.fields.rd;
-	if (rd == 0 && mem_wb_alu.insn.opcode != Opcode::SYSTEM) return 0;
+	// f0 is an ordinary register
+	if (rd == 0 && mem_wb_alu.insn.opcode != Opcode::SYSTEM
+		&& mem_wb_alu.insn.opcode != Opcode::LOAD_FP) return 0;
 
 
 	switch (mem_wb_alu.insn.opcode)
@@ -1047,14 +1163,25 @@ int Pipeline::wb_alu_first_half(unsigned long long clock)
 	case Opcode::LOAD:
 	case Opcode::AMO: {
 		register_file.gpr[rd] = mem_wb_alu.mem_result_i;
+		written_back[int(UNIT::ALU)] = uint64_t(1) << rd;
 		return 0;
 	}
 	case Opcode::LOAD_FP: {
 		register_file.fpr[rd] = mem_wb_alu.mem_result_f;
+		written_back[int(UNIT::ALU)] = uint64_t(1) << (32 + rd);
 		return 0;
 	}
 	case Opcode::SYSTEM:{
 		if (mem_wb_alu.insn.function == Function::ECALL) {
+			++syscalls;
+			if (!config.syscall_drain) {
+				// everything older has written back and nothing younger
+				// has gone to memory, read a0 or entered another unit, so
+				// fetch carries on past the ECALL
+				handle_syscall(register_file, *memory, clock);
+				syscall_busy = config.syscall_cycles;
+				return 0;
+			}
 			iF.syscall_invalidation = true;
 			id.syscall_invalidation = true;
 			ex_alu.syscall_invalidation = true;
@@ -1075,9 +1202,12 @@ int Pipeline::wb_alu_first_half(unsigned long long clock)
 		return 0;
 	}
 	case Opcode::FENCE:
+		if (mem_wb_alu.insn.function == Function::FENCE_I)
+			memory->flush_decode_cache();
 		return 0;
 	default: {
 		register_file.gpr[rd] = mem_wb_alu.alu_result;
+		written_back[int(UNIT::ALU)] = uint64_t(1) << rd;
 		return 0;
 	}
 	}
@@ -1107,6 +1237,7 @@ void Pipeline::wb_muldiv_first_half()
 	int32_t value = mem_wb_muldiv.alu_result;
 
 	register_file.gpr[rd] = value;
+	written_back[int(UNIT::MULDIV)] = uint64_t(1) << rd;
 }
 
 Stage_Result Pipeline::wb_muldiv_second_half()
@@ -1132,6 +1263,7 @@ void Pipeline::wb_fpadd_first_half()
 	float value = mem_wb_fpadd.fpu_result;
 
 	register_file.fpr[rd] = value;
+	written_back[int(UNIT::FADD)] = uint64_t(1) << (32 + rd);
 }
 
 Stage_Result Pipeline::wb_fpadd_second_half()
@@ -1157,6 +1289,7 @@ void Pipeline::wb_fpmul_first_half()
 	float value = mem_wb_fpmul.fpu_result;
 
 	register_file.fpr[rd] = value;
+	written_back[int(UNIT::FMUL)] = uint64_t(1) << (32 + rd);
 }
 
 Stage_Result Pipeline::wb_fpmul_second_half()
@@ -1182,6 +1315,7 @@ void Pipeline::wb_fpdiv_first_half()
 	float value = mem_wb_fpdiv.fpu_result;
 
 	register_file.fpr[rd] = value;
+	written_back[int(UNIT::FDIV)] = uint64_t(1) << (32 + rd);
 }
 
 Stage_Result Pipeline::wb_fpdiv_second_half()
@@ -1195,6 +1329,35 @@ Stage_Result Pipeline::wb_fpdiv_second_half()
 }
 
 
+void Pipeline::report(std::ostream& os) const
+{
+	const char* paths[BYPASS_PATHS] = { "EX->EX", "MEM->EX", "WB->ID" };
+	os << std::dec << "[ bypass ]";
+	for (int path = 0; path < BYPASS_PATHS; ++path) {
+		os << " " << paths[path] << " " << bypass_uses[path];
+		if (config.bypass[path] == 0)
+			os << " (off)";
+		else if (config.bypass[path] != (1u << RESULT_UNITS) - 1)
+			os << " (partial)";
+	}
+	os << std::endl;
+	os << "[ stalls ] RAW: executing " << stalls[int(Hazard::RAW_EXECUTE)]
+		<< " load-use " << stalls[int(Hazard::RAW_LOAD)]
+		<< " no EX->EX " << stalls[int(Hazard::RAW_EX_EX)]
+		<< " no MEM->EX " << stalls[int(Hazard::RAW_MEM_EX)]
+		<< " no WB->ID " << stalls[int(Hazard::RAW_WB_ID)]
+		<< " WAW " << stalls[int(Hazard::WAW)]
+		<< " structural " << stalls[int(Hazard::STRUCTURAL)]
+		<< " syscall drain " << stalls[int(Hazard::SYSCALL_DRAIN)]
+		<< " syscall " << stalls[int(Hazard::SYSCALL)]
+		<< " control " << stalls[int(Hazard::CONTROL)] << std::endl;
+	os << "[ syscall ] " << syscalls << " calls, ";
+	if (config.syscall_drain)
+		os << "drained and refetched" << std::endl;
+	else
+		os << config.syscall_cycles << " cycles each" << std::endl;
+}
+
 void Pipeline::run()
 {
 	unsigned long long clock = 1;
@@ -1216,6 +1379,7 @@ void Pipeline::run()
 		mem_fpadd_first_half();
 		mem_fpmul_first_half();
 		mem_fpdiv_first_half();
+		std::fill(written_back, written_back + RESULT_UNITS, 0);
 		shut_down = wb_alu_first_half(clock);
 		wb_muldiv_first_half();
 		wb_fpadd_first_half();
@@ -1298,6 +1462,7 @@ void Pipeline::run()
 		results[0] = fetch_second_half();
 
 		++clock;
+		caches->tick();
         /*
         const char* stage_str[16] = {
 			"IF", "SYSCALL", "BRANCH",
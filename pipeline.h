@@ -3,6 +3,110 @@
 #include "consts.h"
 #include "memory.h"
 #include "registers.h"
+#include "cache.h"
+#include <deque>
+#include <iostream>
+
+// latency and initiation interval of a multi-cycle unit, see --unit
+struct UnitTiming {
+	uint32_t latency{ 1 };
+	// cycles before the next operation may enter, 1 is fully pipelined
+	uint32_t interval{ 1 };
+};
+
+// where ID takes an operand that is not in the register file yet: from
+// EX/MEM, from MEM/WB, or from the register written back this cycle
+enum class Bypass {
+	EX_EX, MEM_EX, WB_ID
+};
+
+// the dividers are not pipelined
+struct PipelineConfig {
+	UnitTiming mul{ MUL_CYCLE, 1 };
+	UnitTiming div{ DIV_CYCLE, DIV_CYCLE };
+	UnitTiming fpadd{ FP_ADD_CYCLE, 1 };
+	UnitTiming fpmul{ FP_MUL_CYCLE, 1 };
+	UnitTiming fpdiv{ FP_DIV_CYCLE, FP_DIV_CYCLE };
+	// per Bypass, a bit per UNIT whose results it carries
+	uint32_t bypass[BYPASS_PATHS]{ (1u << RESULT_UNITS) - 1, (1u << RESULT_UNITS) - 1, (1u << RESULT_UNITS) - 1 };
+	// cycles fetch and decode are held after an ECALL writes back, 0
+	// for functional-equivalence runs
+	uint32_t syscall_cycles{ SYSCALL_CYCLE };
+	// drain every unit before an ECALL and refetch after it instead
+	bool syscall_drain{ false };
+};
+
+// why ID held or dropped an instruction, see Pipeline::report
+enum class Hazard {
+	// the producer is still executing
+	RAW_EXECUTE,
+	RAW_LOAD,
+	// the value waits for a bypass that is turned off
+	RAW_EX_EX, RAW_MEM_EX, RAW_WB_ID,
+	WAW,
+	STRUCTURAL,
+	// an ECALL waits for the older multiply/divide and FP ops, and the
+	// younger ones for it; with --syscall=drain also for memory
+	SYSCALL_DRAIN,
+	// held by the syscall cost model
+	SYSCALL,
+	// squashed behind a taken branch or jump
+	CONTROL,
+	COUNT
+};
+
+// Operations of a multi-cycle unit between ID/EX and EX/MEM, oldest
+// first. One enters at most every interval cycles and is done latency
+// cycles later, so independent operations overlap; they leave in order.
+template <typename T>
+class MultiCycleUnit {
+	struct Op {
+		Instruction insn{ 0 };
+		T result{};
+		uint32_t step{ 0 };
+		uint32_t latency{ 0 };
+	};
+	std::deque<Op> ops;
+	// cycles until the next operation may enter
+	uint32_t blocked{ 0 };
+
+public:
+	bool empty() const { return ops.empty(); }
+	bool accepts() const { return blocked == 0; }
+	void start(const Instruction& insn, T result, const UnitTiming& timing) {
+		Op op;
+		op.insn = insn;
+		op.result = result;
+		op.latency = timing.latency;
+		ops.push_back(op);
+		blocked = timing.interval;
+	}
+	// one cycle
+	void tick() {
+		for (Op& op : ops) {
+			if (op.step < op.latency)
+				++op.step;
+		}
+		if (blocked > 0)
+			--blocked;
+	}
+	bool done() const { return !ops.empty() && ops.front().step >= ops.front().latency; }
+	const Instruction& insn() const { return ops.front().insn; }
+	T result() const { return ops.front().result; }
+	void pop() { ops.pop_front(); }
+	// an operation in flight writes rd
+	bool writes(uint32_t rd) const {
+		for (const Op& op : ops) {
+			if (op.insn.fields.rd == rd)
+				return true;
+		}
+		return false;
+	}
+	void clear() {
+		ops.clear();
+		blocked = 0;
+	}
+};
 
 // IF/ID
 struct IfIdRegister {
@@ -85,6 +189,7 @@ struct MemWbFpuRegister {
 
 struct IF {
 	uint32_t raw_insn{ 0 };
+	bool ready{ false };
 	uint32_t target_addr{0 };
 
 	bool cond{ false };
@@ -109,9 +214,6 @@ struct EX_INT
 
 struct EX_FP
 {
-	float fpuout{ 0.f };
-	uint8_t step{ 0 };
-	
 	bool nop{ false };
 	bool syscall_invalidation{ false };
 };
@@ -124,7 +226,8 @@ struct MEM_ALU
 	int32_t mem_result_i{ 0 };
 	float mem_result_f{ 0.f };
 	
-	uint8_t step{ 0 };
+	uint32_t step{ 0 };
+	uint32_t latency{ 0 };
 };
 
 struct MEM
@@ -171,6 +274,26 @@ class Pipeline {
 	EX_FP ex_fpmul;
 	EX_FP ex_fpdiv;
 
+	// multi-cycle units behind id_ex_muldiv and id_ex_fp*; the multiplier
+	// and the divider share both latches but not their pipelines
+	PipelineConfig config;
+	MultiCycleUnit<int32_t> mul_unit;
+	MultiCycleUnit<int32_t> div_unit;
+	MultiCycleUnit<float> fpadd_unit;
+	MultiCycleUnit<float> fpmul_unit;
+	MultiCycleUnit<float> fpdiv_unit;
+
+	// per UNIT, registers written back this cycle; f registers from bit 32
+	uint64_t written_back[RESULT_UNITS]{ 0 };
+	// cause of the last RAW stall, and the bypasses the operands of ID use
+	Hazard hazard{ Hazard::RAW_EXECUTE };
+	uint32_t bypassed[BYPASS_PATHS]{ 0 };
+	unsigned long long bypass_uses[BYPASS_PATHS]{ 0 };
+	unsigned long long stalls[int(Hazard::COUNT)]{ 0 };
+	// cycles left of the syscall being charged
+	uint32_t syscall_busy{ 0 };
+	unsigned long long syscalls{ 0 };
+
 	MEM_ALU mem_alu;
 	MEM mem_muldiv;
 	MEM mem_fpadd;
@@ -186,12 +309,19 @@ class Pipeline {
 	Memory* memory{ nullptr };
 	RegisterFile register_file;
 
+	CacheHierarchy* caches{ nullptr };
+	FetchPort fetch_port;
+
 private:	
 	void fetch_first_half();
 	Stage_Result fetch_second_half();
 
 	void id_first_half();
 	bool is_syscall_sync_insn();
+	// an ECALL is between ID and WB
+	bool syscall_in_flight() const;
+	// false if the value can be read in ID, recording the bypass it takes
+	bool bypass(Bypass path, UNIT unit);
 	bool check_gpr_dependency(uint32_t rs);
 	bool check_fpr_dependency(uint32_t rs);
 	bool check_raw_hazard();
@@ -243,13 +373,20 @@ private:
 	
 
 public:
-	Pipeline(Memory* mem, uint32_t entry_point, uint32_t sp) : memory(mem) {
+	Pipeline(Memory* mem, CacheHierarchy* caches, uint32_t entry_point, uint32_t sp)
+		: memory(mem), caches(caches) {
 		register_file.pc = entry_point;
 		register_file.gpr[2] = sp;
 	}
 
+	// resume from an architectural state (e.g. after fast-forwarding)
+	Pipeline(Memory* mem, CacheHierarchy* caches, const RegisterFile& rf
+		, const PipelineConfig& config = PipelineConfig())
+		: config(config), memory(mem), register_file(rf), caches(caches) {}
+
 	
 	void run();
+	void report(std::ostream& os) const;
 
 };
 
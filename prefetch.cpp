@@ -0,0 +1,97 @@
+#include "prefetch.h"
+#include <string.h>
+
+void NextLinePrefetcher::train(uint32_t /*pc*/, uint32_t addr, bool miss, std::vector<uint32_t>& out)
+{
+	if (miss)
+		out.emplace_back((addr / line_size + 1) * line_size);
+}
+
+void StridePrefetcher::train(uint32_t pc, uint32_t addr, bool /*miss*/, std::vector<uint32_t>& out)
+{
+	StrideEntry& e = table[(pc >> 2) % table.size()];
+	if (e.pc != pc) {
+		e.pc = pc;
+		e.last_addr = addr;
+		e.stride = 0;
+		e.confidence = 0;
+		return;
+	}
+
+	int32_t stride = int32_t(addr - e.last_addr);
+	if (stride != 0 && stride == e.stride) {
+		if (e.confidence < 3)
+			++e.confidence;
+	}
+	else {
+		if (e.confidence > 0)
+			--e.confidence;
+		else
+			e.stride = stride;
+	}
+	e.last_addr = addr;
+
+	if (e.confidence >= 2) {
+		for (int i = 1; i <= PREFETCH_DEGREE; ++i)
+			out.emplace_back(addr + e.stride * i);
+	}
+}
+
+void StreamPrefetcher::train(uint32_t /*pc*/, uint32_t addr, bool miss, std::vector<uint32_t>& out)
+{
+	uint32_t line = addr / line_size;
+	++tick;
+
+	// an access inside a stream's window keeps it STREAM_DEPTH lines ahead
+	for (StreamBuffer& s : streams) {
+		if (!s.valid)
+			continue;
+		int32_t ahead = int32_t(s.next_line - line) * s.direction;
+		if (ahead > 0 && ahead <= STREAM_DEPTH) {
+			for (; ahead <= STREAM_DEPTH; ++ahead) {
+				out.emplace_back(s.next_line * line_size);
+				s.next_line += s.direction;
+			}
+			s.last_use = tick;
+			return;
+		}
+	}
+
+	if (!miss)
+		return;
+
+	// two misses to adjacent lines start a stream in that direction
+	int32_t direction = int32_t(line - last_miss_line);
+	last_miss_line = line;
+	if (direction != 1 && direction != -1)
+		return;
+
+	StreamBuffer* victim = &streams[0];
+	for (StreamBuffer& s : streams) {
+		if (!s.valid) {
+			victim = &s;
+			break;
+		}
+		if (s.last_use < victim->last_use)
+			victim = &s;
+	}
+	victim->valid = true;
+	victim->direction = direction;
+	victim->next_line = line + direction;
+	victim->last_use = tick;
+	for (int i = 0; i < STREAM_DEPTH; ++i) {
+		out.emplace_back(victim->next_line * line_size);
+		victim->next_line += direction;
+	}
+}
+
+Prefetcher* make_prefetcher(const char* name, uint32_t line_size)
+{
+	if (strcmp(name, "next") == 0)
+		return new NextLinePrefetcher(line_size);
+	if (strcmp(name, "stride") == 0)
+		return new StridePrefetcher(line_size);
+	if (strcmp(name, "stream") == 0)
+		return new StreamPrefetcher(line_size);
+	return nullptr;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "consts.h"
+
+// Observes the L1D address stream and proposes lines to prefetch
+class Prefetcher {
+protected:
+	uint32_t line_size;
+
+public:
+	Prefetcher(uint32_t line_size) : line_size(line_size) {}
+	virtual ~Prefetcher() {}
+
+	virtual const char* name() const = 0;
+	// appends the addresses to prefetch after a demand access
+	virtual void train(uint32_t pc, uint32_t addr, bool miss, std::vector<uint32_t>& out) = 0;
+};
+
+// prefetches the following line(s) on every miss
+class NextLinePrefetcher : public Prefetcher {
+public:
+	NextLinePrefetcher(uint32_t line_size) : Prefetcher(line_size) {}
+
+	const char* name() const override { return "next-line"; }
+	void train(uint32_t pc, uint32_t addr, bool miss, std::vector<uint32_t>& out) override;
+};
+
+struct StrideEntry {
+	uint32_t pc{ 0 };
+	uint32_t last_addr{ 0 };
+	int32_t stride{ 0 };
+	uint8_t confidence{ 0 };
+};
+
+// reference prediction table indexed by the PC of the memory instruction
+class StridePrefetcher : public Prefetcher {
+	std::vector<StrideEntry> table;
+
+public:
+	StridePrefetcher(uint32_t line_size) : Prefetcher(line_size), table(STRIDE_TABLE_SIZE) {}
+
+	const char* name() const override { return "stride"; }
+	void train(uint32_t pc, uint32_t addr, bool miss, std::vector<uint32_t>& out) override;
+};
+
+struct StreamBuffer {
+	bool valid{ false };
+	// next line to prefetch and the direction in lines
+	uint32_t next_line{ 0 };
+	int32_t direction{ 1 };
+	unsigned long long last_use{ 0 };
+};
+
+// sequential streams allocated on misses, running STREAM_DEPTH lines ahead
+class StreamPrefetcher : public Prefetcher {
+	std::vector<StreamBuffer> streams;
+	uint32_t last_miss_line{ 0 };
+	unsigned long long tick{ 0 };
+
+public:
+	StreamPrefetcher(uint32_t line_size) : Prefetcher(line_size), streams(STREAM_BUFFERS) {}
+
+	const char* name() const override { return "stream"; }
+	void train(uint32_t pc, uint32_t addr, bool miss, std::vector<uint32_t>& out) override;
+};
+
+Prefetcher* make_prefetcher(const char* name, uint32_t line_size);
@@ -0,0 +1,131 @@
+#include "rename.h"
+#include <algorithm>
+#include <cstring>
+
+RenameMap::RenameMap(const RenameConfig& config)
+	: values(config.registers), ready(config.registers), producer(config.registers)
+	, free_list(config.registers), checkpoints(config.checkpoints)
+{
+	if (config.registers <= LOGICAL_REGS || config.registers > 0x10000 || config.checkpoints == 0) {
+		std::clog << "invalid physical register file" << std::endl;
+		exit(1);
+	}
+	RegisterFile empty;
+	reset(empty);
+}
+
+void RenameMap::reset(const RegisterFile& rf)
+{
+	for (uint32_t i = 0; i < LOGICAL_REGS; ++i)
+		rat[i] = retired[i] = uint16_t(i);
+	for (uint32_t i = 0; i < 32; ++i) {
+		int32_t bits;
+		memcpy(&bits, &rf.fpr[i], sizeof(bits));
+		write(i, rf.gpr[i]);
+		write(FP_REG_BASE + i, bits);
+	}
+	free_head = committed_head = 0;
+	free_tail = 0;
+	for (uint32_t p = LOGICAL_REGS; p < values.size(); ++p)
+		free_list[free_tail++] = uint16_t(p);
+	checkpoint_head = checkpoint_count = 0;
+}
+
+bool RenameMap::read(uint32_t rg, int32_t& value, uint32_t& tag) const
+{
+	uint32_t p = rat[rg];
+	if (rg == 0 || ready[p]) {
+		value = rg == 0 ? 0 : values[p];
+		tag = 0;
+		return true;
+	}
+	value = 0;
+	tag = producer[p];
+	return false;
+}
+
+bool RenameMap::can_rename(bool dest, bool branch)
+{
+	if (dest && free_head == free_tail) {
+		++free_stalls;
+		return false;
+	}
+	if (branch && checkpoint_count == checkpoints.size()) {
+		++checkpoint_stalls;
+		return false;
+	}
+	return true;
+}
+
+uint32_t RenameMap::rename(uint32_t rd, uint32_t tag, uint32_t& old)
+{
+	uint32_t p = free_list[free_head++ % free_list.size()];
+	ready[p] = 0;
+	producer[p] = tag;
+	old = rat[rd];
+	rat[rd] = uint16_t(p);
+
+	uint32_t in_use = uint32_t(values.size()) - (free_tail - free_head);
+	if (in_use > peak_in_use)
+		peak_in_use = in_use;
+	return p;
+}
+
+uint32_t RenameMap::checkpoint()
+{
+	uint32_t c = (checkpoint_head + checkpoint_count++) % checkpoints.size();
+	std::copy(rat, rat + LOGICAL_REGS, checkpoints[c].map);
+	checkpoints[c].free_head = free_head;
+	return c;
+}
+
+void RenameMap::commit(uint32_t rd, uint32_t reg, uint32_t old)
+{
+	retired[rd] = uint16_t(reg);
+	free_list[free_tail++ % free_list.size()] = uint16_t(old);
+	++committed_head;
+}
+
+void RenameMap::restore(uint32_t checkpoint)
+{
+	++restores;
+	const RatCheckpoint& c = checkpoints[checkpoint];
+	std::copy(c.map, c.map + LOGICAL_REGS, rat);
+	free_head = c.free_head;
+	// the branch itself stays live until it commits
+	checkpoint_count = (checkpoint + checkpoints.size() - checkpoint_head) % checkpoints.size() + 1;
+}
+
+void RenameMap::recover()
+{
+	std::copy(retired, retired + LOGICAL_REGS, rat);
+	free_head = committed_head;
+	checkpoint_count = 0;
+}
+
+void RenameMap::read_architectural(RegisterFile& rf) const
+{
+	for (uint32_t i = 1; i < 32; ++i)
+		rf.gpr[i] = values[retired[i]];
+	for (uint32_t i = 0; i < 32; ++i)
+		memcpy(&rf.fpr[i], &values[retired[FP_REG_BASE + i]], sizeof(float));
+}
+
+// also marks them ready: the syscall result in a0 never goes out on the CDB
+void RenameMap::write_architectural(const RegisterFile& rf)
+{
+	for (uint32_t i = 1; i < 32; ++i)
+		write(retired[i], rf.gpr[i]);
+	for (uint32_t i = 0; i < 32; ++i) {
+		int32_t bits;
+		memcpy(&bits, &rf.fpr[i], sizeof(bits));
+		write(retired[FP_REG_BASE + i], bits);
+	}
+}
+
+void RenameMap::report(std::ostream& os) const
+{
+	os << std::dec << "[ rename ] " << values.size() << " physical registers, peak in use "
+		<< peak_in_use << " free list stalls " << free_stalls << " checkpoint stalls "
+		<< checkpoint_stalls << " restores " << restores << std::endl;
+}
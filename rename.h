@@ -0,0 +1,96 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+#include "consts.h"
+#include "registers.h"
+
+struct RenameConfig {
+	// physical registers, 0 renames through the ROB
+	uint32_t registers{ 0 };
+	// branches in flight, each holding a RAT checkpoint
+	uint32_t checkpoints{ RENAME_CHECKPOINTS };
+};
+
+// the speculative map as a branch was renamed
+struct RatCheckpoint {
+	uint16_t map[LOGICAL_REGS];
+	uint32_t free_head{ 0 };
+};
+
+// Merged physical register file in the R10K style, shared by the integer
+// and FP registers. The RAT maps each
+// architectural register to a physical one and the free list hands out a
+// new destination at rename; the previous mapping of rd returns to the
+// free list when the instruction commits. A branch takes a RAT checkpoint
+// at rename, so a mispredict restores the map and the free list at once.
+class RenameMap {
+	std::vector<int32_t> values;
+	std::vector<uint8_t> ready;
+	// ROB tag of the instruction that writes each register
+	std::vector<uint32_t> producer;
+
+	// x0-x31, then f0-f31 from FP_REG_BASE on
+	uint16_t rat[LOGICAL_REGS];
+	// committed map, read by syscalls and full flushes
+	uint16_t retired[LOGICAL_REGS];
+
+	// circular, [free_head, free_tail) are free; the counters only grow
+	std::vector<uint16_t> free_list;
+	uint32_t free_head{ 0 };
+	uint32_t free_tail{ 0 };
+	// free_head as of the last committed rename
+	uint32_t committed_head{ 0 };
+
+	// oldest live checkpoint first
+	std::vector<RatCheckpoint> checkpoints;
+	uint32_t checkpoint_head{ 0 };
+	uint32_t checkpoint_count{ 0 };
+
+	unsigned long long free_stalls{ 0 };
+	unsigned long long checkpoint_stalls{ 0 };
+	unsigned long long restores{ 0 };
+	uint32_t peak_in_use{ 0 };
+
+public:
+	RenameMap(const RenameConfig& config);
+
+	// maps x0-x31 and f0-f31 onto p0-p63 holding the values of rf; an
+	// FP register holds the bits of its float
+	void reset(const RegisterFile& rf);
+
+	// the value of rg, or false and the ROB tag it waits for
+	bool read(uint32_t rg, int32_t& value, uint32_t& tag) const;
+	// false, and counts the stall, if rename has to wait
+	bool can_rename(bool dest, bool branch);
+	// maps rd to a free register written by tag; old is the previous mapping
+	uint32_t rename(uint32_t rd, uint32_t tag, uint32_t& old);
+	uint32_t checkpoint();
+
+	void write(uint32_t reg, int32_t value) {
+		values[reg] = value;
+		ready[reg] = 1;
+	}
+	void commit(uint32_t rd, uint32_t reg, uint32_t old);
+	// the oldest branch committed without a mispredict
+	void release() {
+		checkpoint_head = (checkpoint_head + 1) % checkpoints.size();
+		--checkpoint_count;
+	}
+	// back to the map of a branch, dropping every younger checkpoint
+	void restore(uint32_t checkpoint);
+	// walks back the youngest rename, for a squash without a checkpoint
+	void undo(uint32_t rd, uint32_t old) {
+		rat[rd] = uint16_t(old);
+		--free_head;
+	}
+	// drops the youngest checkpoint
+	void drop() { --checkpoint_count; }
+	// back to the committed map
+	void recover();
+
+	void read_architectural(RegisterFile& rf) const;
+	void write_architectural(const RegisterFile& rf);
+
+	void report(std::ostream& os) const;
+};
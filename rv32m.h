@@ -0,0 +1,57 @@
+#pragma once
+#include "instruction.h"
+#include <stdint.h>
+
+// RV32M arithmetic shared by every engine
+// division by zero and overflow do not trap: a zero divisor gives -1 or the
+// dividend, INT32_MIN / -1 gives the dividend or 0
+
+inline int32_t rv32m_mul(int32_t A, int32_t B) { return int32_t(int64_t(A) * int64_t(B)); }
+inline int32_t rv32m_mulh(int32_t A, int32_t B) { return int32_t((int64_t(A) * int64_t(B)) >> 32); }
+inline int32_t rv32m_mulhsu(int32_t A, int32_t B) { return int32_t((int64_t(A) * int64_t(uint32_t(B))) >> 32); }
+inline int32_t rv32m_mulhu(int32_t A, int32_t B) { return int32_t((uint64_t(uint32_t(A)) * uint64_t(uint32_t(B))) >> 32); }
+
+inline int32_t rv32m_div(int32_t A, int32_t B)
+{
+	if (B == 0) return -1;
+	if (A == INT32_MIN && B == -1) return A;
+	return A / B;
+}
+inline int32_t rv32m_divu(int32_t A, int32_t B)
+{
+	if (B == 0) return -1;
+	return int32_t(uint32_t(A) / uint32_t(B));
+}
+inline int32_t rv32m_rem(int32_t A, int32_t B)
+{
+	if (B == 0) return A;
+	if (A == INT32_MIN && B == -1) return 0;
+	return A % B;
+}
+inline int32_t rv32m_remu(int32_t A, int32_t B)
+{
+	if (B == 0) return A;
+	return int32_t(uint32_t(A) % uint32_t(B));
+}
+
+inline bool rv32m_is_div(Function function)
+{
+	return function == Function::DIV || function == Function::DIVU
+		|| function == Function::REM || function == Function::REMU;
+}
+
+inline int32_t rv32m(Function function, int32_t A, int32_t B)
+{
+	switch (function)
+	{
+	case Function::MUL: return rv32m_mul(A, B);
+	case Function::MULH: return rv32m_mulh(A, B);
+	case Function::MULHSU: return rv32m_mulhsu(A, B);
+	case Function::MULHU: return rv32m_mulhu(A, B);
+	case Function::DIV: return rv32m_div(A, B);
+	case Function::DIVU: return rv32m_divu(A, B);
+	case Function::REM: return rv32m_rem(A, B);
+	case Function::REMU: return rv32m_remu(A, B);
+	default: return 0;
+	}
+}
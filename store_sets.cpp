@@ -0,0 +1,56 @@
+#include "store_sets.h"
+
+StoreSets::StoreSets(const StoreSetConfig& config)
+	: ssit(config.ssit_entries), lfst(config.lfst_entries)
+{
+	if (config.ssit_entries == 0 || (config.ssit_entries & (config.ssit_entries - 1)) != 0
+		|| config.lfst_entries == 0) {
+		std::clog << "invalid store set geometry" << std::endl;
+		exit(1);
+	}
+}
+
+uint32_t StoreSets::load(uint32_t pc)
+{
+	// stale sets would keep unrelated loads waiting forever
+	if (++lookups % STORE_SET_RESET == 0)
+		std::fill(ssit.begin(), ssit.end(), 0);
+
+	uint32_t set = set_of(pc);
+	if (set == 0 || lfst[set - 1] == 0)
+		return 0;
+	++predicted;
+	return lfst[set - 1];
+}
+
+uint32_t StoreSets::store(uint32_t pc, uint32_t tag)
+{
+	uint32_t set = set_of(pc);
+	if (set != 0)
+		lfst[set - 1] = tag;
+	return set;
+}
+
+void StoreSets::violation(uint32_t store_pc, uint32_t load_pc)
+{
+	++violations;
+	uint32_t& s = set_of(store_pc);
+	uint32_t& l = set_of(load_pc);
+	// both join the smaller set, or a new one
+	if (s == 0 && l == 0) {
+		s = l = next_set + 1;
+		next_set = (next_set + 1) % lfst.size();
+	}
+	else if (s == 0)
+		s = l;
+	else if (l == 0 || s < l)
+		l = s;
+	else
+		s = l;
+}
+
+void StoreSets::report(std::ostream& os) const
+{
+	os << std::dec << "[ store sets ] speculative loads " << speculative << " predicted dependences "
+		<< predicted << " violations " << violations << std::endl;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include "consts.h"
+
+struct StoreSetConfig {
+	// store set ID table entries, power of two; 0 never issues a load
+	// past a store with an unknown address
+	uint32_t ssit_entries{ SSIT_SIZE };
+	// last fetched store table entries, the number of sets
+	uint32_t lfst_entries{ LFST_SIZE };
+};
+
+// Store set memory dependence predictor after Chrysos and Emer. A load and
+// a store that once conflicted are put in the same set; the load then waits
+// for the last store of its set issued before it, and otherwise executes
+// past older stores whose addresses are still unknown.
+class StoreSets {
+	// set + 1 per PC, 0 for none
+	std::vector<uint32_t> ssit;
+	// ROB tag of the last store issued in each set, 0 for none
+	std::vector<uint32_t> lfst;
+	uint32_t next_set{ 0 };
+	unsigned long long lookups{ 0 };
+
+	uint32_t& set_of(uint32_t pc) { return ssit[(pc >> 2) & (ssit.size() - 1)]; }
+
+public:
+	unsigned long long speculative{ 0 };
+	unsigned long long predicted{ 0 };
+	unsigned long long violations{ 0 };
+
+	StoreSets(const StoreSetConfig& config);
+
+	// the store tag a load at pc waits for, or 0
+	uint32_t load(uint32_t pc);
+	// records the store tag as the last of its set; returns the set + 1
+	uint32_t store(uint32_t pc, uint32_t tag);
+	// the store committed or was squashed
+	void forget(uint32_t set, uint32_t tag) {
+		if (set != 0 && lfst[set - 1] == tag)
+			lfst[set - 1] = 0;
+	}
+	// every in-flight store is gone
+	void flush() { std::fill(lfst.begin(), lfst.end(), 0); }
+	// a load at load_pc read before the older store at store_pc
+	void violation(uint32_t store_pc, uint32_t load_pc);
+
+	void report(std::ostream& os) const;
+};
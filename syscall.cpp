@@ -6,14 +6,45 @@
 #include <sys/uio.h>
 #include <sys/mman.h>
 #include <iostream>
+#include <vector>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/utsname.h>
+#include <stdio.h>
+#include <string.h>
 
 
 using namespace std;
 
+static vector<function<void()>> exit_reports;
+static FILE* syscall_trace{ nullptr };
+
+void add_exit_report(function<void()> report)
+{
+	exit_reports.emplace_back(report);
+}
+
+bool trace_syscalls(const char* path)
+{
+	syscall_trace = fopen(path, "w");
+	return syscall_trace != nullptr;
+}
+
+// one line per syscall: x1-x31, the bits of f0-f31 and the memory checksum
+static void trace_syscall(const RegisterFile& register_file, const Memory& memory)
+{
+	for (int i = 1; i < 32; ++i)
+		fprintf(syscall_trace, "%08x ", uint32_t(register_file.gpr[i]));
+	for (int i = 0; i < 32; ++i) {
+		uint32_t bits;
+		memcpy(&bits, &register_file.fpr[i], sizeof(bits));
+		fprintf(syscall_trace, "%08x ", bits);
+	}
+	fprintf(syscall_trace, "%016llx\n", (unsigned long long)memory.checksum());
+	fflush(syscall_trace);
+}
+
 uint32_t sys_bark(long a0) {
 	return a0;
 }
@@ -26,7 +57,7 @@ int sys_openat(long dirfd, long name, long flags, long mode, Memory& memory)
 
 int sys_uname(long buf, Memory& memory)
 {
-	return uname((struct utsname*)memory.get_ptr(buf));
+	return uname((struct utsname*)memory.get_writable_ptr(buf, sizeof(struct utsname)));
 }
 
 int sys_getuid()
@@ -36,12 +67,60 @@ int sys_getuid()
 
 int sys_readlinkat(long dirfd, long pathname, long buf, long bufsize, Memory& memory)
 {
-    return readlinkat(dirfd, memory.get_ptr(pathname), memory.get_ptr(buf), bufsize);
+    return readlinkat(dirfd, memory.get_ptr(pathname), memory.get_writable_ptr(buf, bufsize), bufsize);
 }
 
+// struct stat of the RV32 Linux ABI, asm-generic/stat.h with a 32-bit long
+struct GuestStat {
+	uint32_t dev;
+	uint32_t ino;
+	uint32_t mode;
+	uint32_t nlink;
+	uint32_t uid;
+	uint32_t gid;
+	uint32_t rdev;
+	uint32_t pad1;
+	int32_t size;
+	int32_t blksize;
+	int32_t pad2;
+	int32_t blocks;
+	int32_t atime;
+	uint32_t atime_nsec;
+	int32_t mtime;
+	uint32_t mtime_nsec;
+	int32_t ctime;
+	uint32_t ctime_nsec;
+	uint32_t unused4;
+	uint32_t unused5;
+};
+static_assert(sizeof(GuestStat) == 80, "RV32 struct stat is 80 bytes");
+
 int sys_fstat(long fd, long buf, Memory& memory)
 {
-    return fstat(fd, (struct stat*)memory.get_ptr(buf));
+	struct stat host;
+	int ret = fstat(fd, &host);
+	if (ret != 0)
+		return ret;
+
+	GuestStat guest{};
+	guest.dev = uint32_t(host.st_dev);
+	guest.ino = uint32_t(host.st_ino);
+	guest.mode = host.st_mode;
+	guest.nlink = uint32_t(host.st_nlink);
+	guest.uid = host.st_uid;
+	guest.gid = host.st_gid;
+	guest.rdev = uint32_t(host.st_rdev);
+	guest.size = int32_t(host.st_size);
+	guest.blksize = int32_t(host.st_blksize);
+	guest.blocks = int32_t(host.st_blocks);
+	guest.atime = int32_t(host.st_atim.tv_sec);
+	guest.atime_nsec = uint32_t(host.st_atim.tv_nsec);
+	guest.mtime = int32_t(host.st_mtim.tv_sec);
+	guest.mtime_nsec = uint32_t(host.st_mtim.tv_nsec);
+	guest.ctime = int32_t(host.st_ctim.tv_sec);
+	guest.ctime_nsec = uint32_t(host.st_ctim.tv_nsec);
+	memcpy(memory.get_writable_ptr(buf, sizeof(GuestStat)), &guest, sizeof(GuestStat));
+	return 0;
 }
 
 int sys_write(long fd, long buf, long count, Memory& memory){
@@ -73,6 +152,8 @@ long do_syscall(long a0, long a1, long a2, long a3, long a4, long a5, unsigned l
     case SYS_exit_group:
         std::clog << "bye~!" << std::endl;
         std::clog << std::dec << "[ clock ] " << clock << std::endl;
+        for (auto& report : exit_reports)
+            report();
         exit(0);
     default:
         std::clog << "not defined syscall " << std::dec << n << std::endl;
@@ -85,6 +166,8 @@ long do_syscall(long a0, long a1, long a2, long a3, long a4, long a5, unsigned l
 
 void handle_syscall(RegisterFile& register_file, Memory& memory, unsigned long long clock)
 {
+	if (syscall_trace)
+		trace_syscall(register_file, memory);
 	register_file.gpr[10] = do_syscall(register_file.gpr[10]
 		, register_file.gpr[11], register_file.gpr[12], register_file.gpr[13],
 		register_file.gpr[14], register_file.gpr[15], register_file.gpr[17], memory, clock);
@@ -1,6 +1,7 @@
 #pragma once
 #include "registers.h"
 #include "memory.h"
+#include <functional>
 
 #define SYS_exit 93
 #define SYS_exit_group 94
@@ -66,3 +67,10 @@
 void handle_syscall(RegisterFile& register_file, Memory& memory, unsigned long long clock);
 
 long do_syscall(long a0, long a1, long a2, long a3, long a4, long a5, unsigned long n, unsigned long long clock);
+
+// printed after the clock count when the guest exits
+void add_exit_report(std::function<void()> report);
+
+// writes the registers and a memory checksum to path before every syscall,
+// so two engines can be compared at each ECALL
+bool trace_syscalls(const char* path);
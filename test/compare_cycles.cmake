@@ -0,0 +1,31 @@
+# cmake -DSIM=<simulator> -DPYTHON=<python3> -DSOURCE=<program.s> -DNAME=<test>
+#   -DFAST="<options> <type>" -DSLOW="<options> <type>" -DMARGIN=<cycles> -P compare_cycles.cmake
+#
+# Assembles SOURCE and runs it on FAST and on SLOW. Fails unless SLOW takes
+# at most MARGIN clock cycles more than FAST.
+set(dir ${CMAKE_CURRENT_BINARY_DIR})
+set(elf ${dir}/${NAME}.elf)
+get_filename_component(assembler ${CMAKE_CURRENT_LIST_DIR}/rvasm.py ABSOLUTE)
+
+execute_process(COMMAND ${PYTHON} ${assembler} ${SOURCE} ${elf} RESULT_VARIABLE failed)
+if(failed)
+	message(FATAL_ERROR "cannot assemble ${SOURCE}")
+endif()
+
+foreach(run FAST SLOW)
+	separate_arguments(options UNIX_COMMAND "${${run}}")
+	execute_process(COMMAND ${SIM} ${options} ${elf}
+		OUTPUT_QUIET ERROR_VARIABLE report RESULT_VARIABLE failed TIMEOUT 60)
+	if(failed)
+		message(FATAL_ERROR "${${run}} run failed: ${failed}")
+	endif()
+	if(NOT report MATCHES "\\[ clock \\] ([0-9]+)")
+		message(FATAL_ERROR "${${run}} reports no clock")
+	endif()
+	set(${run}_clock ${CMAKE_MATCH_1})
+endforeach()
+
+math(EXPR extra "${SLOW_clock} - ${FAST_clock}")
+if(extra GREATER MARGIN)
+	message(FATAL_ERROR "${SLOW} takes ${SLOW_clock} cycles, ${extra} more than the ${FAST_clock} of ${FAST}")
+endif()
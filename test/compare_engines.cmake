@@ -0,0 +1,43 @@
+# cmake -DSIM=<simulator> -DPYTHON=<python3> -DSOURCE=<program.s> -DNAME=<test>
+#   -DENGINE="<options> <type>" [-DREFERENCE="<options> <type>"] -P compare_engines.cmake
+#
+# Assembles SOURCE and runs it on REFERENCE (default the interpreter, type 4
+# without the JIT) and on ENGINE, each with --ecall-trace. Fails unless both
+# print the same and reach the same registers and memory at every ECALL.
+set(dir ${CMAKE_CURRENT_BINARY_DIR})
+set(elf ${dir}/${NAME}.elf)
+get_filename_component(assembler ${CMAKE_CURRENT_LIST_DIR}/rvasm.py ABSOLUTE)
+
+execute_process(COMMAND ${PYTHON} ${assembler} ${SOURCE} ${elf} RESULT_VARIABLE failed)
+if(failed)
+	message(FATAL_ERROR "cannot assemble ${SOURCE}")
+endif()
+
+if(NOT REFERENCE)
+	set(REFERENCE "--jit=off 4")
+endif()
+separate_arguments(reference UNIX_COMMAND "${REFERENCE}")
+execute_process(COMMAND ${SIM} --ecall-trace=${dir}/${NAME}.expected ${reference} ${elf}
+	OUTPUT_VARIABLE expected ERROR_QUIET RESULT_VARIABLE failed TIMEOUT 60)
+if(failed)
+	message(FATAL_ERROR "${REFERENCE} run failed: ${failed}")
+endif()
+
+separate_arguments(engine UNIX_COMMAND "${ENGINE}")
+execute_process(COMMAND ${SIM} --ecall-trace=${dir}/${NAME}.actual ${engine} ${elf}
+	OUTPUT_VARIABLE actual ERROR_QUIET RESULT_VARIABLE failed TIMEOUT 60)
+if(failed)
+	message(FATAL_ERROR "${ENGINE} run failed: ${failed}")
+endif()
+
+if(NOT actual STREQUAL expected)
+	message(FATAL_ERROR "output differs:\n${expected}\n${actual}")
+endif()
+file(READ ${dir}/${NAME}.expected expected_trace)
+file(READ ${dir}/${NAME}.actual actual_trace)
+if(expected_trace STREQUAL "")
+	message(FATAL_ERROR "no ECALL reached")
+endif()
+if(NOT actual_trace STREQUAL expected_trace)
+	message(FATAL_ERROR "state differs at an ECALL, see ${dir}/${NAME}.expected and ${NAME}.actual")
+endif()
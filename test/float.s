@@ -0,0 +1,62 @@
+# flw/fsw and FADD/FSUB/FMUL/FDIV over an array
+.text
+_start:
+  li s0, 0
+  la t5, fdata
+  flw ft1, 4(t5)
+  flw ft4, 8(t5)
+  flw ft5, 12(t5)
+  flw fs0, 8(t5)
+  la s1, arr
+  li t0, 0
+  li t1, 300
+floop:
+  andi t2, t0, 31
+  slli t2, t2, 2
+  add t2, t2, s1
+  flw fa0, 0(t2)
+  fmul.s fa1, fa0, ft1
+  fadd.s fa1, fa1, ft4
+  fsw fa1, 0(t2)
+  flw fa2, 0(t2)
+  fdiv.s fa3, fa2, ft5
+  fadd.s fs0, fs0, fa3
+  fsub.s fs0, fs0, ft4
+  fsw fa3, 4(t2)
+  addi t0, t0, 1
+  blt t0, t1, floop
+  fsw fs0, 16(t5)
+  lw t2, 16(t5)
+  add s0, s0, t2
+hexstart:
+  la t5, buf
+  li t0, 28
+hex:
+  srl t2, s0, t0
+  andi t2, t2, 15
+  li t3, 10
+  blt t2, t3, dig
+  addi t2, t2, 87
+  j st
+dig:
+  addi t2, t2, 48
+st:
+  sb t2, 0(t5)
+  addi t5, t5, 1
+  addi t0, t0, -4
+  bge t0, zero, hex
+  li t2, 10
+  sb t2, 0(t5)
+  li a0, 1
+  la a1, buf
+  li a2, 9
+  li a7, 64
+  ecall
+  li a0, 0
+  li a7, 93
+  ecall
+.data
+fdata: .float 1.5, 0.75, 0.25, 1.25
+  .word 0, 0
+buf: .space 16
+arr: .float 1.0, 1.5, 2.0, 2.5, 3.0, 3.5, 4.0, 4.5, 5.0, 5.5, 6.0, 6.5, 7.0, 7.5, 8.0, 8.5, 9.0, 9.5, 10.0, 10.5, 11.0, 11.5, 12.0, 12.5, 13.0, 13.5, 14.0, 14.5, 15.0, 15.5, 16.0, 16.5, 17.0, 17.5, 18.0, 18.5, 19.0, 19.5, 20.0, 20.5
@@ -0,0 +1,36 @@
+# fstat on stdout fills the 80-byte RV32 struct stat and nothing after it
+.text
+_start:
+  li a0, 1
+  la a1, st
+  li a7, 80
+  ecall
+  bne a0, zero, fail
+  la s0, st
+  lw t0, 80(s0)
+  li t1, 0x5a5a5a5a
+  bne t0, t1, fail
+  lw t0, 84(s0)
+  bne t0, t1, fail
+  # st_mode carries a file type
+  lw t0, 8(s0)
+  srli t0, t0, 12
+  beq t0, zero, fail
+  # clear what differs between runs before the next ECALL
+  li t0, 0
+clear:
+  add t3, s0, t0
+  sw zero, 0(t3)
+  addi t0, t0, 4
+  li t3, 80
+  blt t0, t3, clear
+  li a0, 0
+  li a7, 93
+  ecall
+fail:
+  # an undefined syscall exits with status 1
+  li a7, 0
+  ecall
+.data
+st: .space 80
+canary: .word 0x5a5a5a5a, 0x5a5a5a5a
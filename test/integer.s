@@ -0,0 +1,176 @@
+# multiply/divide including the RV32M corner cases, insertion sort,
+# recursion, AMOs and a code patch behind fence.i
+.text
+_start:
+  li s0, 0
+  li t0, 0
+  li t1, 300
+loop1:
+  mul t2, t0, t0
+  add s0, s0, t2
+  addi t0, t0, 1
+  blt t0, t1, loop1
+  li a0, 1000003
+  li a1, 97
+  div t2, a0, a1
+  add s0, s0, t2
+  rem t2, a0, a1
+  xor s0, s0, t2
+  li a1, -7
+  divu t2, a0, a1
+  add s0, s0, t2
+  div t2, a0, a1
+  add s0, s0, t2
+  mulh t2, a0, a1
+  add s0, s0, t2
+  mulhu t2, a0, a0
+  add s0, s0, t2
+  # divide by zero and overflow do not trap
+  li t0, 0x80000000
+  li t1, -1
+  div t2, a0, zero
+  add s0, s0, t2
+  divu t2, a0, zero
+  add s0, s0, t2
+  rem t2, a0, zero
+  add s0, s0, t2
+  remu t2, a0, zero
+  add s0, s0, t2
+  div t2, t0, t1
+  add s0, s0, t2
+  rem t2, t0, t1
+  add s0, s0, t2
+  mulhsu t2, t1, t1
+  add s0, s0, t2
+  mulhu t2, t1, t0
+  add s0, s0, t2
+  la s1, arr
+  li t0, 0
+  li t1, 64
+  li t3, 12345
+  li t4, 1103515245
+fill:
+  mul t3, t3, t4
+  addi t3, t3, 1234
+  slli t5, t0, 2
+  add t5, t5, s1
+  srli t6, t3, 8
+  sw t6, 0(t5)
+  addi t0, t0, 1
+  blt t0, t1, fill
+  mv a0, s1
+  li a1, 64
+  call isort
+  li t0, 0
+sum2:
+  slli t5, t0, 2
+  add t5, t5, s1
+  lw t6, 0(t5)
+  li t2, 31
+  mul s0, s0, t2
+  add s0, s0, t6
+  addi t0, t0, 1
+  blt t0, t1, sum2
+  li a0, 12
+  call fib
+  add s0, s0, a0
+  la t5, counter
+  li t6, 5
+  amoadd.w t2, t6, (t5)
+  add s0, s0, t2
+  amoadd.w t2, t6, (t5)
+  add s0, s0, t2
+  lr.w t2, (t5)
+  addi t2, t2, 3
+  sc.w t3, t2, (t5)
+  add s0, s0, t3
+  lw t2, 0(t5)
+  add s0, s0, t2
+  li t6, 100
+  amomax.w t2, t6, (t5)
+  add s0, s0, t2
+  lw t2, 0(t5)
+  add s0, s0, t2
+  la t5, smc
+  li t6, 0x00700513
+  sw t6, 0(t5)
+  fence.i
+  la t5, buf
+  li t0, 28
+hex:
+  srl t2, s0, t0
+  andi t2, t2, 15
+  li t3, 10
+  blt t2, t3, dig
+  addi t2, t2, 87
+  j st
+dig:
+  addi t2, t2, 48
+st:
+  sb t2, 0(t5)
+  addi t5, t5, 1
+  addi t0, t0, -4
+  bge t0, zero, hex
+  li t2, 10
+  sb t2, 0(t5)
+  li a0, 1
+  la a1, buf
+  li a2, 9
+  li a7, 64
+  ecall
+  li a0, 0
+  li a7, 93
+  ecall
+isort:
+  li t0, 1
+outer:
+  bge t0, a1, done
+  slli t2, t0, 2
+  add t2, t2, a0
+  lw t3, 0(t2)
+  addi t4, t0, -1
+inner:
+  blt t4, zero, ins
+  slli t5, t4, 2
+  add t5, t5, a0
+  lw t6, 0(t5)
+  bge t3, t6, ins
+  sw t6, 4(t5)
+  addi t4, t4, -1
+  j inner
+ins:
+  slli t5, t4, 2
+  add t5, t5, a0
+  sw t3, 4(t5)
+  addi t0, t0, 1
+  j outer
+done:
+  ret
+fib:
+  li t0, 2
+  blt a0, t0, fib_ret
+  addi sp, sp, -16
+  sw ra, 12(sp)
+  sw a0, 8(sp)
+  addi a0, a0, -1
+  call fib
+  sw a0, 4(sp)
+  lw a0, 8(sp)
+  addi a0, a0, -2
+  call fib
+  lw t0, 4(sp)
+  add a0, a0, t0
+  lw ra, 12(sp)
+  addi sp, sp, 16
+fib_ret:
+  ret
+smc:
+  addi a0, zero, 1
+  ret
+.data
+arr: .space 256
+scratch: .word 0
+fdata: .float 1.5, 0.75, 0.25, 1.25
+  .word 0, 0
+counter: .word 10
+buf: .space 16
@@ -0,0 +1,47 @@
+# one divide followed by a stream of independent multiplies
+.text
+_start:
+  li a0, 1000003
+  li a1, 97
+  li t1, 3
+  li t2, 5
+  div s0, a0, a1
+  mul t3, t1, t2
+  mul t4, t1, t2
+  mul t5, t1, t2
+  mul t6, t1, t2
+  mul t3, t1, t2
+  mul t4, t1, t2
+  mul t5, t1, t2
+  mul t6, t1, t2
+  mul t3, t1, t2
+  mul t4, t1, t2
+  mul t5, t1, t2
+  mul t6, t1, t2
+  mul t3, t1, t2
+  mul t4, t1, t2
+  mul t5, t1, t2
+  mul t6, t1, t2
+  mul t3, t1, t2
+  mul t4, t1, t2
+  mul t5, t1, t2
+  mul t6, t1, t2
+  mul t3, t1, t2
+  mul t4, t1, t2
+  mul t5, t1, t2
+  mul t6, t1, t2
+  mul t3, t1, t2
+  mul t4, t1, t2
+  mul t5, t1, t2
+  mul t6, t1, t2
+  mul t3, t1, t2
+  mul t4, t1, t2
+  mul t5, t1, t2
+  mul t6, t1, t2
+  mul t3, t1, t2
+  mul t4, t1, t2
+  mul t5, t1, t2
+  mul t6, t1, t2
+  add a0, s0, t3
+  li a7, 93
+  ecall
@@ -0,0 +1,148 @@
+# Minimal RV32IMAF assembler for the test programs: one .text and one .data
+# section, labels, li/la/call/ret/mv/j pseudo-instructions.
+# usage: rvasm.py <source.s> <out.elf>
+import struct, sys
+
+REG = {f"x{i}": i for i in range(32)}
+ABI = "zero ra sp gp tp t0 t1 t2 s0 s1 a0 a1 a2 a3 a4 a5 a6 a7 s2 s3 s4 s5 s6 s7 s8 s9 s10 s11 t3 t4 t5 t6".split()
+for i, n in enumerate(ABI): REG[n] = i
+REG["fp"] = 8
+FREG = {f"f{i}": i for i in range(32)}
+FABI = "ft0 ft1 ft2 ft3 ft4 ft5 ft6 ft7 fs0 fs1 fa0 fa1 fa2 fa3 fa4 fa5 fa6 fa7 fs2 fs3 fs4 fs5 fs6 fs7 fs8 fs9 fs10 fs11 ft8 ft9 ft10 ft11".split()
+for i, n in enumerate(FABI): FREG[n] = i
+
+def r(op, rd, f3, rs1, rs2, f7): return (f7 << 25) | (rs2 << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) | op
+def i_(op, rd, f3, rs1, imm): return ((imm & 0xfff) << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) | op
+def s_(op, f3, rs1, rs2, imm):
+    imm &= 0xfff
+    return ((imm >> 5) << 25) | (rs2 << 20) | (rs1 << 15) | (f3 << 12) | ((imm & 0x1f) << 7) | op
+def b_(f3, rs1, rs2, off):
+    off &= 0x1fff
+    return (((off >> 12) & 1) << 31) | (((off >> 5) & 0x3f) << 25) | (rs2 << 20) | (rs1 << 15) | (f3 << 12) | (((off >> 1) & 0xf) << 8) | (((off >> 11) & 1) << 7) | 0x63
+def j_(rd, off):
+    off &= 0x1fffff
+    return (((off >> 20) & 1) << 31) | (((off >> 1) & 0x3ff) << 21) | (((off >> 11) & 1) << 20) | (((off >> 12) & 0xff) << 12) | (rd << 7) | 0x6f
+
+OPR = {"add": (0, 0), "sub": (0, 0x20), "sll": (1, 0), "slt": (2, 0), "sltu": (3, 0), "xor": (4, 0), "srl": (5, 0), "sra": (5, 0x20), "or": (6, 0), "and": (7, 0),
+       "mul": (0, 1), "mulh": (1, 1), "mulhsu": (2, 1), "mulhu": (3, 1), "div": (4, 1), "divu": (5, 1), "rem": (6, 1), "remu": (7, 1)}
+OPI = {"addi": 0, "slti": 2, "sltiu": 3, "xori": 4, "ori": 6, "andi": 7}
+SH = {"slli": (1, 0), "srli": (5, 0), "srai": (5, 0x20)}
+LD = {"lb": 0, "lh": 1, "lw": 2, "lbu": 4, "lhu": 5}
+ST = {"sb": 0, "sh": 1, "sw": 2}
+BR = {"beq": 0, "bne": 1, "blt": 4, "bge": 5, "bltu": 6, "bgeu": 7}
+AMO = {"amoswap.w": 1, "amoadd.w": 0, "amoxor.w": 4, "amoand.w": 12, "amoor.w": 8, "amomin.w": 16, "amomax.w": 20, "amominu.w": 24, "amomaxu.w": 28, "lr.w": 2, "sc.w": 3}
+FOP = {"fadd.s": 0, "fsub.s": 4, "fmul.s": 8, "fdiv.s": 12}
+
+def memarg(a):
+    off, reg = a.split("(")
+    return (int(off, 0) if off else 0), REG[reg.rstrip(")")]
+
+def assemble(src, text_base=0x10000, data_base=0x12000):
+    text, data, labels = [], bytearray(), {}
+    lines = []
+    sect = "text"
+    # pass 1: sizes
+    pc = text_base
+    for ln in src.splitlines():
+        ln = ln.split("#")[0].strip()
+        if not ln: continue
+        if ln in (".text", ".data"): sect = ln[1:]; lines.append((sect, None)); continue
+        while ":" in ln:
+            lab, ln = ln.split(":", 1); ln = ln.strip()
+            labels[lab.strip()] = pc if sect == "text" else data_base + len(data)
+        if not ln: continue
+        if sect == "data":
+            parts = ln.split(None, 1)
+            if parts[0] == ".word":
+                for v in parts[1].split(","): data += struct.pack("<I", int(v, 0) & 0xffffffff)
+            elif parts[0] == ".float":
+                for v in parts[1].split(","): data += struct.pack("<f", float(v))
+            elif parts[0] == ".space": data += bytes(int(parts[1], 0))
+            elif parts[0] == ".ascii": data += parts[1].strip().strip('"').encode().decode("unicode_escape").encode("latin1")
+            continue
+        op = ln.split(None, 1)[0]
+        n = 2 if op in ("li", "la", "call") else 1
+        lines.append(("text", (pc, ln)))
+        pc += 4 * n
+    # pass 2
+    for sect, item in lines:
+        if item is None: continue
+        pc, ln = item
+        parts = ln.split(None, 1)
+        op = parts[0]; args = [a.strip() for a in parts[1].split(",")] if len(parts) > 1 else []
+        def L(x): return labels[x] if x in labels else int(x, 0)
+        out = []
+        if op in OPR: f3, f7 = OPR[op]; out.append(r(0x33, REG[args[0]], f3, REG[args[1]], REG[args[2]], f7))
+        elif op in OPI: out.append(i_(0x13, REG[args[0]], OPI[op], REG[args[1]], int(args[2], 0)))
+        elif op in SH: f3, f7 = SH[op]; out.append(r(0x13, REG[args[0]], f3, REG[args[1]], int(args[2], 0), f7))
+        elif op in LD: o, b = memarg(args[1]); out.append(i_(0x03, REG[args[0]], LD[op], b, o))
+        elif op in ST: o, b = memarg(args[1]); out.append(s_(0x23, ST[op], b, REG[args[0]], o))
+        elif op in BR: out.append(b_(BR[op], REG[args[0]], REG[args[1]], L(args[2]) - pc))
+        elif op == "flw": o, b = memarg(args[1]); out.append(i_(0x07, FREG[args[0]], 2, b, o))
+        elif op == "fsw": o, b = memarg(args[1]); out.append(s_(0x27, 2, b, FREG[args[0]], o))
+        elif op in FOP: out.append(r(0x53, FREG[args[0]], 7, FREG[args[1]], FREG[args[2]], FOP[op]))
+        elif op in AMO:
+            rd = REG[args[0]]
+            if op == "lr.w": out.append(r(0x2f, rd, 2, memarg(args[1])[1], 0, AMO[op] << 2))
+            else: out.append(r(0x2f, rd, 2, memarg(args[2])[1], REG[args[1]], AMO[op] << 2))
+        elif op == "lui": out.append((int(args[1], 0) << 12) & 0xfffff000 | (REG[args[0]] << 7) | 0x37)
+        elif op == "auipc": out.append((int(args[1], 0) << 12) & 0xfffff000 | (REG[args[0]] << 7) | 0x17)
+        elif op in ("li", "la"):
+            v = L(args[1]) & 0xffffffff
+            lo = v & 0xfff
+            if lo >= 0x800: lo -= 0x1000
+            hi = ((v - lo) >> 12) & 0xfffff
+            out.append((hi << 12) | (REG[args[0]] << 7) | 0x37)
+            out.append(i_(0x13, REG[args[0]], 0, REG[args[0]], lo))
+        elif op == "jal":
+            if len(args) == 1: args = ["ra"] + args
+            out.append(j_(REG[args[0]], L(args[1]) - pc))
+        elif op == "j": out.append(j_(0, L(args[0]) - pc))
+        elif op == "call":
+            out.append(j_(1, L(args[0]) - pc)); out.append(0x13)
+        elif op == "jalr":
+            if len(args) == 1: out.append(i_(0x67, 1, 0, REG[args[0]], 0))
+            else: o, b = memarg(args[1]); out.append(i_(0x67, REG[args[0]], 0, b, o))
+        elif op == "ret": out.append(i_(0x67, 0, 0, 1, 0))
+        elif op == "mv": out.append(i_(0x13, REG[args[0]], 0, REG[args[1]], 0))
+        elif op == "nop": out.append(0x13)
+        elif op == "ecall": out.append(0x73)
+        elif op == "fence.i": out.append(0x100f)
+        elif op == "fence": out.append(0x0ff0000f)
+        elif op == "beqz": out.append(b_(0, REG[args[0]], 0, L(args[1]) - pc))
+        elif op == "bnez": out.append(b_(1, REG[args[0]], 0, L(args[1]) - pc))
+        else: raise SystemExit("bad op " + ln)
+        text += out
+    return text, data, labels
+
+def write_elf(fn, text, data, entry, text_base=0x10000, data_base=0x12000, bss=0x4000, labels={}):
+    tb = b"".join(struct.pack("<I", w) for w in text)
+    ehsz, phsz = 52, 32
+    toff = 0x1000
+    doff = toff + ((len(tb) + 0xfff) & ~0xfff)
+    eh = b"\x7fELF\x01\x01\x01" + bytes(9) + struct.pack("<HHIIIIIHHHHHH", 2, 243, 1, entry, ehsz, 0, 0, ehsz, phsz, 2, 40, 0, 0)
+    ph1 = struct.pack("<IIIIIIII", 1, toff, text_base, text_base, len(tb), len(tb), 5, 0x1000)
+    ph2 = struct.pack("<IIIIIIII", 1, doff, data_base, data_base, len(data), len(data) + bss, 6, 0x1000)
+    img = bytearray(eh + ph1 + ph2)
+    img += bytes(toff - len(img)); img += tb
+    img += bytes(doff - len(img)); img += data
+    # symtab + strtab + section headers
+    strtab = bytearray(b"\0"); syms = bytearray(bytes(16))
+    for k, v in labels.items():
+        syms += struct.pack("<IIIBBH", len(strtab), v, 0, 0x12 if v < data_base else 0x11, 0, 1)
+        strtab += k.encode() + b"\0"
+    symoff = len(img); img += syms
+    stroff = len(img); img += strtab
+    while len(img) % 4: img += b"\0"
+    shoff = len(img)
+    img += bytes(40)
+    img += struct.pack("<IIIIIIIIII", 0, 2, 0, 0, symoff, len(syms), 2, 1, 4, 16)
+    img += struct.pack("<IIIIIIIIII", 0, 3, 0, 0, stroff, len(strtab), 0, 0, 1, 0)
+    struct.pack_into("<IH", img, 32, shoff, 0)
+    struct.pack_into("<HHH", img, 46, 40, 3, 0)
+    open(fn, "wb").write(img)
+
+if __name__ == "__main__":
+    src = open(sys.argv[1]).read()
+    text, data, labels = assemble(src)
+    write_elf(sys.argv[2], text, data, labels["_start"], labels=labels)
@@ -0,0 +1,77 @@
+# a write syscall per iteration with its length from a multiply, a store
+# to the buffer right behind it and FP ops in flight across it
+.text
+_start:
+  li s0, 0
+  li s1, 0
+  li s2, 0
+  la s3, cbuf
+  la t5, fdata
+  flw ft0, 0(t5)
+  flw ft1, 4(t5)
+loop:
+  andi t0, s1, 15
+  addi t0, t0, 97
+  sb t0, 0(s3)
+  li t1, 1
+  li t2, 1
+  fdiv.s ft2, ft0, ft1
+  fmul.s ft3, ft0, ft1
+  li a0, 1
+  mv a1, s3
+  mul a2, t1, t2
+  li a7, 64
+  ecall
+  li t3, 33
+  sb t3, 0(s3)
+  lb t4, 0(s3)
+  add s2, s2, t4
+  add s0, s0, a0
+  fadd.s ft0, ft0, ft3
+  addi s1, s1, 1
+  li t6, 60
+  blt s1, t6, loop
+  li t0, 10
+  sb t0, 0(s3)
+  li a0, 1
+  mv a1, s3
+  li a2, 1
+  li a7, 64
+  ecall
+  slli s0, s0, 16
+  add s0, s0, s2
+  fsw ft0, 8(t5)
+  lw t2, 8(t5)
+  add s0, s0, t2
+hexstart:
+  la t5, buf
+  li t0, 28
+hex:
+  srl t2, s0, t0
+  andi t2, t2, 15
+  li t3, 10
+  blt t2, t3, dig
+  addi t2, t2, 87
+  j st
+dig:
+  addi t2, t2, 48
+st:
+  sb t2, 0(t5)
+  addi t5, t5, 1
+  addi t0, t0, -4
+  bge t0, zero, hex
+  li t2, 10
+  sb t2, 0(t5)
+  li a0, 1
+  la a1, buf
+  li a2, 9
+  li a7, 64
+  ecall
+  li a0, 0
+  li a7, 93
+  ecall
+.data
+fdata: .float 1.5, 0.75
+  .word 0, 0
+cbuf: .space 4
+buf: .space 16
@@ -0,0 +1,25 @@
+# reads a0 right after each write syscall returns
+.text
+_start:
+  li s0, 0
+  li s1, 0
+loop:
+  li a0, 1
+  la a1, msg
+  li a2, 3
+  li a7, 64
+  ecall
+  addi a2, a0, 0
+  li a0, 1
+  la a1, msg
+  li a7, 64
+  ecall
+  add s0, s0, a0
+  addi s1, s1, 1
+  li t0, 20
+  blt s1, t0, loop
+  mv a0, s0
+  li a7, 93
+  ecall
+.data
+msg: .ascii "ok\n"
@@ -1,17 +1,182 @@
 #include "tomasulo.h"
+#include "rv32m.h"
 #include "syscall.h"
 #include <iostream>
+#include <cstring>
 
+void ReservationStation::insert(const RS_ENTRY& rs)
+{
+	uint32_t slot = first_slot(~busy & all);
+	uint64_t bit = uint64_t(1) << slot;
+	slots[slot] = rs;
+	age[slot] = next_age++;
+	busy |= bit;
+	if (rs.Qj != 0)
+		waiters[rs.Qj] |= bit;
+	if (rs.Qk != 0)
+		waiters[rs.Qk] |= bit;
+	if (rs.Qj == 0 && rs.Qk == 0)
+		ready |= bit;
+}
+
+void ReservationStation::wakeup(uint32_t tag, int32_t value)
+{
+	// a squash can leave bits behind for slots that were removed since
+	uint64_t m = waiters[tag] & busy;
+	waiters[tag] = 0;
+	for (; m != 0; m &= m - 1) {
+		uint32_t slot = first_slot(m);
+		RS_ENTRY& rs = slots[slot];
+		if (rs.Qj == tag) {
+			rs.Vj = value;
+			rs.Qj = 0;
+		}
+		if (rs.Qk == tag) {
+			rs.Vk = value;
+			rs.Qk = 0;
+		}
+		if (rs.Qj == 0 && rs.Qk == 0)
+			ready |= uint64_t(1) << slot;
+	}
+}
+
+uint32_t ReservationStation::by_age(uint64_t mask, uint32_t* out) const
+{
+	uint32_t n = 0;
+	for (; mask != 0; mask &= mask - 1) {
+		uint32_t slot = first_slot(mask);
+		uint32_t k = n++;
+		for (; k > 0 && age[out[k - 1]] > age[slot]; --k)
+			out[k] = out[k - 1];
+		out[k] = slot;
+	}
+	return n;
+}
+
+uint32_t ReservationStation::select(uint32_t* out, uint32_t limit) const
+{
+	uint32_t n = by_age(ready & ~started, out);
+	if (limit > width)
+		limit = width;
+	return n < limit ? n : limit;
+}
+
+void ReservationStation::clear()
+{
+	busy = started = ready = 0;
+	reserved = 0;
+	std::fill(waiters.begin(), waiters.end(), 0);
+}
+
+StoreQueue::StoreQueue(uint32_t capacity)
+	: entries(capacity), unresolved((capacity + 63) / 64)
+{
+	uint32_t n = 1;
+	while (n < capacity * 2)
+		n <<= 1;
+	buckets.resize(n);
+}
+
+unsigned long long StoreQueue::push(uint32_t rob)
+{
+	Entry& e = at(tail);
+	e.rob = rob;
+	e.words = 0;
+	set_unresolved(tail, true);
+	return tail++;
+}
+
+void StoreQueue::resolve(unsigned long long seq, uint32_t addr, uint32_t size)
+{
+	Entry& e = at(seq);
+	e.addr = addr;
+	e.size = size;
+	e.word[0] = addr >> 2;
+	e.word[1] = (addr + size - 1) >> 2;
+	e.words = e.word[1] != e.word[0] ? 2 : 1;
+	set_unresolved(seq, false);
+
+	// stores resolve out of order, so each chain is kept sorted by age
+	for (uint32_t i = 0; i < e.words; ++i) {
+		uint32_t b = bucket_of(e.word[i]);
+		unsigned long long* link = &buckets[b];
+		while (*link > head && *link - 1 > seq) {
+			Entry& older = at(*link - 1);
+			link = &older.next[bucket_of(older.word[0]) == b ? 0 : 1];
+		}
+		e.next[i] = *link;
+		*link = seq + 1;
+	}
+}
+
+void StoreQueue::truncate(unsigned long long keep)
+{
+	// the dropped stores are the youngest, so they head their chains
+	while (tail > keep) {
+		Entry& e = at(--tail);
+		for (uint32_t i = 0; i < e.words; ++i) {
+			unsigned long long& b = buckets[bucket_of(e.word[i])];
+			if (b == tail + 1)
+				b = e.next[i];
+		}
+		set_unresolved(tail, false);
+	}
+}
+
+void StoreQueue::clear()
+{
+	head = tail;
+	std::fill(buckets.begin(), buckets.end(), 0);
+	std::fill(unresolved.begin(), unresolved.end(), 0);
+}
+
+bool StoreQueue::unresolved_in(unsigned long long from, unsigned long long to) const
+{
+	while (from < to) {
+		uint32_t slot = uint32_t(from % entries.size());
+		uint32_t bit = slot % 64;
+		unsigned long long n = std::min<unsigned long long>({ 64 - bit, to - from, entries.size() - slot });
+		uint64_t mask = n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1) << bit;
+		if (unresolved[slot / 64] & mask)
+			return true;
+		from += n;
+	}
+	return false;
+}
+
+void StoreQueue::older(uint32_t addr, uint32_t size, unsigned long long end, std::vector<StoreMatch>& out)
+{
+	out.clear();
+	uint32_t first = addr >> 2;
+	uint32_t last = (addr + size - 1) >> 2;
+	for (uint32_t w = first; w <= last; ++w) {
+		uint32_t b = bucket_of(w);
+		// links to committed stores end the chain
+		for (unsigned long long link = buckets[b]; link > head; ) {
+			Entry& e = at(link - 1);
+			uint32_t i = bucket_of(e.word[0]) == b ? 0 : 1;
+			// a misaligned store was met in the chain of its first word
+			bool seen = i == 1 && e.word[0] >= first;
+			if (link - 1 < end && !seen && e.addr < addr + size && addr < e.addr + e.size)
+				out.push_back(StoreMatch{ link - 1, e.rob, e.addr, e.size });
+			link = e.next[i];
+		}
+	}
+	if (first != last)
+		std::sort(out.begin(), out.end(), [](const StoreMatch& a, const StoreMatch& b) { return a.seq > b.seq; });
+}
 
 bool Tomasulo::get_operand(uint32_t rg, int32_t & value, uint32_t & nROB)
 {
+	if (rename)
+		return rename->read(rg, value, nROB);
 	if (rg == 0) {
 		value = 0;
 		nROB = 0;
 		return true;
 	}
 	if (register_stat[rg].busy == true) {
-		ROB_ENTRY* src = (ROB_ENTRY*)(register_stat[rg].nROB);
+		ROB_ENTRY* src = &ROB_queue[register_stat[rg].nROB];
 		if (src->complete) {
 			value = src->value;
 			nROB = 0;
@@ -19,57 +184,255 @@ bool Tomasulo::get_operand(uint32_t rg, int32_t & value, uint32_t & nROB)
 		}
 		else {
 			value = 0;
-			nROB = uint32_t(src);
+			nROB = register_stat[rg].nROB;
 			return false;
 		}
 	}
 
-	value = register_file.gpr[rg];
+	if (rg >= FP_REG_BASE)
+		memcpy(&value, &register_file.fpr[rg - FP_REG_BASE], sizeof(value));
+	else
+		value = register_file.gpr[rg];
 	nROB = 0;
 	return true;
 }
 
-Stage_Result Tomasulo::fetch_n_decode()
+static float as_float(int32_t bits)
 {
-	uint32_t raw_insn = memory->read_int(
-		uint32_t(register_file.pc), WORD_SIZE);
-
-	Instruction insn{ raw_insn };
-	insn.fields.pc = register_file.pc;
-	insn.decode();
-
-    if(insn.opcode == Opcode::STORE_FP || insn.opcode == Opcode::LOAD_FP || insn.opcode == Opcode::OP_FP){
-        Instruction nop{ 0x13 };
-        nop.fields.pc = register_file.pc;
-        nop.decode();
-        insn = nop;
-    }
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+static int32_t as_bits(float f)
+{
+	int32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
 
-	if (insn.opcode == Opcode::BRANCH
-		|| insn.opcode == Opcode::JAL) {
-		register_file.pc += int32_t(insn.fields.imm);
-		insn.taken = true;
+// integer and FP loads and stores share the memory pipeline
+static bool is_load(Opcode op)
+{
+	return op == Opcode::LOAD || op == Opcode::LOAD_FP;
+}
+
+static bool is_store(Opcode op)
+{
+	return op == Opcode::STORE || op == Opcode::STORE_FP;
+}
+
+// the register status / rename map index of the destination
+static uint32_t dest_of(const Instruction& insn)
+{
+	if (insn.opcode == Opcode::LOAD_FP || insn.opcode == Opcode::OP_FP)
+		return FP_REG_BASE + insn.fields.rd;
+	return insn.fields.rd;
+}
+
+// x1 and x5 are link registers for return address prediction
+static bool is_link(uint32_t reg)
+{
+	return reg == 1 || reg == 5;
+}
+
+static bool is_return(const Instruction& insn)
+{
+	return is_link(insn.fields.rs1)
+		&& (!is_link(insn.fields.rd) || insn.fields.rd != insn.fields.rs1);
+}
+
+// the register insn writes once renamed, 0 for none
+static uint32_t written_reg(const Instruction& insn)
+{
+	if (is_store(insn.opcode) || insn.opcode == Opcode::BRANCH)
+		return 0;
+	if (insn.function == Function::ECALL)
+		return 10;
+	return dest_of(insn);
+}
+
+bool Tomasulo::unrenamed_writer(uint32_t rg, const FetchTarget& ft) const
+{
+	if (rg == 0)
+		return false;
+	for (const Instruction& insn : instrunction_queue) {
+		if (written_reg(insn) == rg)
+			return true;
+	}
+	for (const FetchTarget& older : FTQ) {
+		for (uint32_t k = older.consumed; k < older.insns.size(); ++k) {
+			if (written_reg(older.insns[k]) == rg)
+				return true;
+		}
 	}
-	else if (insn.opcode == Opcode::JALR) {
-		int32_t value{ 0 };
-		uint32_t nROB{ 0 };
-		bool availabe = get_operand(insn.fields.rs1, value, nROB );
-		if (availabe == false)
-			return Stage_Result::RAW;
+	for (const Instruction& insn : ft.insns) {
+		if (written_reg(insn) == rg)
+			return true;
+	}
+	return false;
+}
 
-		register_file.pc = int32_t(insn.fields.imm) + value;
-		register_file.pc = register_file.pc & 0xfffffffe; // LSB -> 0
-		insn.taken = true;
+Stage_Result Tomasulo::predict_fetch_target()
+{
+	if (redirect_stall > 0) {
+		--redirect_stall;
+		return Stage_Result::BRANCH_STALL;
 	}
-	else {
-		register_file.pc += WORD_SIZE;
+	if (FTQ.size() >= front_end.ftq_size) {
+		++ftq_full;
+		return Stage_Result::STRUCTURAL;
 	}
 
-	instrunction_queue.emplace_back(insn);
+	// a fetch block ends at the block boundary or the first predicted-taken
+	// control transfer
+	FetchTarget ft;
+	ft.pc = uint32_t(register_file.pc);
+	uint32_t block_end = (ft.pc & ~(front_end.block_size - 1)) + front_end.block_size;
+	while (uint32_t(register_file.pc) < block_end && uint32_t(register_file.pc) >= ft.pc) {
+	    Instruction insn = memory->fetch_insn(uint32_t(register_file.pc));
+
+	    bool redirect = false;
+	    if (insn.opcode == Opcode::BRANCH) {
+		    if(predictor == nullptr){
+                register_file.pc += int32_t(insn.fields.imm);
+		        insn.taken = true;
+	        }
+            else{
+                if(predictor->predict(insn.fields.pc, insn.checkpoint)){
+                    register_file.pc += int32_t(insn.fields.imm);
+		            insn.taken = true;
+                }
+                else{
+                    register_file.pc += WORD_SIZE;
+                    insn.taken = false;
+                }
+            }
+        }
+        else if(insn.opcode == Opcode::JAL){
+            if(targets){
+                uint32_t target;
+                ++targets->btb_lookups;
+                if (!targets->btb.lookup(insn.fields.pc, target)) {
+                    // the target is known only after decode
+                    ++targets->btb_misses;
+                    redirect = true;
+                }
+                if (is_link(insn.fields.rd))
+                    targets->ras.push(insn.fields.pc + WORD_SIZE);
+            }
+            register_file.pc += int32_t(insn.fields.imm);
+		    insn.taken = true;
+        }
+	    else if (insn.opcode == Opcode::JALR) {
+            uint32_t target{ 0 };
+            bool predicted = false;
+            if (targets) {
+                if (is_return(insn)) {
+                    target = targets->ras.peek();
+                    predicted = true;
+                }
+                else
+                    predicted = targets->btb.lookup(insn.fields.pc, target);
+            }
+
+            if (!predicted) {
+		        int32_t value{ 0 };
+		        uint32_t nROB{ 0 };
+		        bool availabe = get_operand(insn.fields.rs1, value, nROB );
+		        // the register state does not know a producer still in the
+		        // front end, its stale value would cost a squash
+		        if (unrenamed_writer(insn.fields.rs1, ft))
+			        availabe = false;
+		        if (availabe == false) {
+			        // close the block before the JALR and wait for rs1
+			        if (ft.insns.empty())
+				        return Stage_Result::RAW;
+			        break;
+		        }
+		        target = (int32_t(insn.fields.imm) + value) & 0xfffffffe; // LSB -> 0
+            }
+
+            if (targets) {
+                if (!is_return(insn)) {
+                    ++targets->btb_lookups;
+                    if (!predicted)
+                        ++targets->btb_misses;
+                }
+                if (is_return(insn))
+                    targets->ras.pop();
+                if (is_link(insn.fields.rd))
+                    targets->ras.push(insn.fields.pc + WORD_SIZE);
+            }
+            // a squash behind a wrong target rewinds the history to here
+            if (predictor)
+                insn.checkpoint = predictor->checkpoint();
+		    register_file.pc = target;
+		    insn.next_pc = target;
+		    insn.taken = true;
+	    }
+	    else {
+		    register_file.pc += WORD_SIZE;
+	    }
+
+	    if (targets)
+		    targets->ras.checkpoint(insn.ras_top, insn.ras_value);
+	    ft.insns.emplace_back(insn);
+
+	    if (redirect) {
+		    redirect_stall = BTB_MISS_PENALTY;
+		    break;
+	    }
+	    if (insn.taken)
+		    break;
+    }
 
+	++fetch_blocks;
+	fetch_block_insns += ft.insns.size();
+	FTQ.emplace_back(std::move(ft));
 	return Stage_Result::IF;
 }
 
+Stage_Result Tomasulo::fetch_n_decode()
+{
+	if (FTQ.empty())
+		return Stage_Result::NOP;
+
+	// one I-cache access per fetch block
+	FetchTarget& ft = FTQ.front();
+	if (!fetch_port.ready(caches, ft.pc)) {
+		++icache_stalls;
+		return Stage_Result::ICACHE_STALL;
+	}
+
+	for (uint32_t n = 0; n < front_end.fetch_width && ft.consumed < ft.insns.size(); ++n) {
+	    if (instrunction_queue.size() >= front_end.buffer_size) {
+		    ++buffer_full;
+		    return Stage_Result::STRUCTURAL;
+	    }
+	    instrunction_queue.emplace_back(ft.insns[ft.consumed++]);
+	}
+
+	// the rest of the fetch width is lost at a block boundary
+	if (ft.consumed == ft.insns.size()) {
+		FTQ.pop_front();
+		fetch_port.consume();
+	}
+	return Stage_Result::IF;
+}
+
+void Tomasulo::report(std::ostream& os) const
+{
+	double average = fetch_blocks ? double(fetch_block_insns) / fetch_blocks : 0.0;
+	os << std::dec << "[ front end ] fetch blocks " << fetch_blocks << " (" << average
+		<< " insns) FTQ full " << ftq_full << " fetch buffer full " << buffer_full
+		<< " I-cache stalls " << icache_stalls << std::endl;
+	os << "[ core ] issue " << core.issue_width << " dispatch " << core.dispatch_width
+		<< " CDB " << core.cdb_width << " commit " << core.commit_width
+		<< " results held by a full CDB " << cdb_stalls << std::endl;
+	os << "[ squash ] early redirects " << squashes << " squashed insns " << squashed << std::endl;
+}
+
 void Tomasulo::fill_RSentry(const Instruction & insn, RS_ENTRY & rs, uint32_t nROB)
 {
 	rs.function = insn.function;
@@ -80,13 +443,30 @@ void Tomasulo::fill_RSentry(const Instruction & insn, RS_ENTRY & rs, uint32_t nR
 	switch (insn.opcode)
 	{
 	case Opcode::JAL:
-	case Opcode::JALR:
 	{
 		rs.Vj = insn.fields.pc;
 		rs.Vk = WORD_SIZE;
 		rs.Qj = 0; rs.Qk = 0;
 		return;
 	}
+	case Opcode::JALR:
+	{
+		// the link goes to rd, the target to the ROB entry for checking
+		rs.A = insn.fields.pc + WORD_SIZE;
+		uint32_t nROB;
+		int32_t value;
+		if (get_operand(insn.fields.rs1, value, nROB)) {
+			rs.Vj = value;
+			rs.Qj = 0;
+		}
+		else {
+			rs.Vj = 0;
+			rs.Qj = nROB;
+		}
+		rs.Vk = insn.fields.imm;
+		rs.Qk = 0;
+		return;
+	}
 	case Opcode::SYSTEM:
 	{
 		rs.Vj = insn.fields.pc;
@@ -116,6 +496,8 @@ void Tomasulo::fill_RSentry(const Instruction & insn, RS_ENTRY & rs, uint32_t nR
 	}
 	case Opcode::LOAD:
 	case Opcode::STORE:
+	case Opcode::LOAD_FP:
+	case Opcode::STORE_FP:
 	{
 		uint32_t nROB;
 		int32_t value;
@@ -177,6 +559,29 @@ void Tomasulo::fill_RSentry(const Instruction & insn, RS_ENTRY & rs, uint32_t nR
 		return;
 	}
 
+	case Opcode::OP_FP:
+	{
+		uint32_t nROB;
+		int32_t value;
+		bool availabe = get_operand(FP_REG_BASE + insn.fields.rs1, value, nROB);
+		if (availabe) {
+			rs.Vj = value;
+			rs.Qj = 0;
+		}
+		else {
+			rs.Vj = 0;
+			rs.Qj = nROB;
+		}
+		availabe = get_operand(FP_REG_BASE + insn.fields.rs2, value, nROB);
+		if (availabe) {
+			rs.Vk = value; rs.Qk = 0;
+		}
+		else {
+			rs.Vk = 0; rs.Qk = nROB;
+		}
+		return;
+	}
+
 	case Opcode::BRANCH:
 	case Opcode::OP:
 	{
@@ -206,75 +611,111 @@ void Tomasulo::fill_RSentry(const Instruction & insn, RS_ENTRY & rs, uint32_t nR
 	}
 }
 
-Stage_Result Tomasulo::issue()
+ReservationStation& Tomasulo::station_of(const Instruction& insn)
 {
-	if (instrunction_queue.empty())
-		return Stage_Result::NOP;
-	
-	Instruction& insn = instrunction_queue.front();
-
-	// create a ROB entry
-	ROB_queue.emplace_back(insn);
-	ROB_queue.back().rd = insn.fields.rd;
-	if (insn.function == Function::ECALL)
-		ROB_queue.back().rd = 10;
-    if(insn.opcode == Opcode::STORE){
-        ROB_queue.back().complete = true;
-    }
-	if (insn.opcode == Opcode::STORE
-		||(insn.function == Function::SC_W)) {
-		uint32_t nROB;
-		int32_t value;
-		bool availabe = get_operand(insn.fields.rs2, value, nROB);
-		if (availabe) {
-			ROB_queue.back().mem_value = value;
-			ROB_queue.back().ready_value = true;
-			ROB_queue.back().src = 0;
-		}
-		else {
-			ROB_queue.back().src = nROB;
-			ROB_queue.back().mem_value = 0;
-			ROB_queue.back().ready_value = false;
-		}
-	}
-
-
-	// cread a RS entry
-	RS_ENTRY rs;
-	fill_RSentry(insn, rs, uint32_t(&ROB_queue.back()));
-
-	if (insn.opcode == Opcode::STORE
-		|| insn.opcode == Opcode::LOAD
+	if (is_store(insn.opcode)
+		|| is_load(insn.opcode)
 		|| insn.opcode == Opcode::AMO)
+		return ADDR_RS;
+	if (insn.opcode == Opcode::OP_FP)
+		return FP_RS;
+
+	switch (insn.function)
 	{
-		ADDR_RS.emplace_back(rs);
+	case Function::MUL:
+	case Function::MULH:
+	case Function::MULHSU:
+	case Function::MULHU:
+	case Function::DIV:
+	case Function::DIVU:
+	case Function::REM:
+	case Function::REMU:
+		return MULDIV_RS;
+	default:
+		return ALU_RS;
 	}
-	else
-	{
-		switch (insn.function)
-		{
-		case Function::MUL:
-		case Function::MULH:
-		case Function::MULHSU:
-		case Function::MULHU:
-		case Function::DIV:
-		case Function::DIVU:
-		case Function::REM:
-		case Function::REMU: {
-			MULDIV_RS.emplace_back(rs);
-			break;
+}
+
+Stage_Result Tomasulo::issue()
+{
+	for (uint32_t nWay = 0; nWay < core.issue_width; ++nWay) {
+		if (instrunction_queue.empty())
+			return Stage_Result::NOP;
+		if (ROB_queue.full())
+			return Stage_Result::STRUCTURAL;
+
+		Instruction& insn = instrunction_queue.front();
+		ReservationStation& station = station_of(insn);
+		if (station.full())
+			return Stage_Result::STRUCTURAL;
+		// loads and AMOs hold a load buffer entry from issue on, so the
+		// buffer fills in program order
+		bool load = is_load(insn.opcode) || insn.opcode == Opcode::AMO;
+		if (load && LOAD_BUFFER.full())
+			return Stage_Result::STRUCTURAL;
+		bool store = is_store(insn.opcode)
+			|| (insn.opcode == Opcode::AMO && insn.function != Function::LR_W);
+		if (store && SQ.full())
+			return Stage_Result::STRUCTURAL;
+		bool branch = insn.opcode == Opcode::BRANCH || insn.opcode == Opcode::JALR;
+		if (rename && !rename->can_rename(dest_of(insn) != 0 || insn.function == Function::ECALL, branch))
+			return Stage_Result::STRUCTURAL;
+
+		// create a ROB entry
+		ROB_queue.push(insn);
+		ROB_queue.back().rd = dest_of(insn);
+		ROB_queue.back().sq_end = SQ.end();
+		if (store)
+			ROB_queue.back().sq_seq = SQ.push(ROB_queue.back_tag());
+		if (insn.function == Function::ECALL)
+			ROB_queue.back().rd = 10;
+		if (is_store(insn.opcode)) {
+			ROB_queue.back().complete = true;
 		}
-		default: {
-			ALU_RS.emplace_back(rs);
-			break;
+		if (is_store(insn.opcode)
+			|| (insn.function == Function::SC_W)) {
+			uint32_t nROB;
+			int32_t value;
+			uint32_t rs2 = insn.opcode == Opcode::STORE_FP ? FP_REG_BASE + insn.fields.rs2 : insn.fields.rs2;
+			bool availabe = get_operand(rs2, value, nROB);
+			if (availabe) {
+				ROB_queue.back().mem_value = value;
+				ROB_queue.back().ready_value = true;
+				ROB_queue.back().src = 0;
+			}
+			else {
+				ROB_queue.back().src = nROB;
+				ROB_queue.wait_value(ROB_queue.back_tag(), nROB);
+				ROB_queue.back().mem_value = 0;
+				ROB_queue.back().ready_value = false;
+			}
 		}
+		if (store_sets && is_load(insn.opcode))
+			ROB_queue.back().store_dep = store_sets->load(insn.fields.pc);
+		else if (store_sets && is_store(insn.opcode))
+			ROB_queue.back().store_set = store_sets->store(insn.fields.pc, ROB_queue.back_tag());
+
+		// cread a RS entry
+		RS_ENTRY rs;
+		fill_RSentry(insn, rs, ROB_queue.back_tag());
+
+		station.insert(rs);
+		if (load) {
+			LOAD_BUFFER.reserve();
+			ROB_queue.back().load_reserved = true;
 		}
-	}
 
-	instrunction_queue.pop_front();
-	if (ROB_queue.back().rd != 0) {
-		register_stat[ROB_queue.back().rd].busy = true;
-		register_stat[ROB_queue.back().rd].nROB = uint32_t(&ROB_queue.back());
+		instrunction_queue.pop_front();
+		if (ROB_queue.back().rd != 0) {
+			if (rename)
+				ROB_queue.back().pdest = rename->rename(ROB_queue.back().rd, ROB_queue.back_tag(), ROB_queue.back().pold);
+			else {
+				register_stat[ROB_queue.back().rd].busy = true;
+				register_stat[ROB_queue.back().rd].nROB = ROB_queue.back_tag();
+			}
+		}
+		if (rename && branch)
+			ROB_queue.back().rat_checkpoint = rename->checkpoint();
 	}
 
 	return Stage_Result::ISSUE;
@@ -285,130 +726,138 @@ Stage_Result Tomasulo::execute_alu()
 	if (ALU_RS.empty())
 		return Stage_Result::NOP;
 	
-	std::list<RS_ENTRY>::iterator i = ALU_RS.begin();
-	while (i != ALU_RS.end()) {
-		if (i->Qj == 0 && i->Qk == 0) {
-			switch (i->function)
-			{
-			case Function::ADD:
-				++(i->cycle);
-				i->result = i->Vj + i->Vk;
-				break;
-			case Function::SUB:
-				++(i->cycle);
-				i->result = i->Vj - i->Vk;
-				break;
-			case Function::SLL: {
-				++(i->cycle);
-				uint8_t shamt = i->Vk & 0x1f;
-				i->result = (i->Vj << shamt);
-				break;
-			}
-			case Function::SRA: {
-				++(i->cycle);
-				uint8_t shamt = i->Vk & 0x1f;
-				i->result = (i->Vj >> shamt);
-				break;
-			}
-			case Function::SRL: {
-				++(i->cycle);
-				uint8_t shamt = i->Vk & 0x1f;
-				uint32_t A = uint32_t(i->Vj);
-				i->result = uint32_t(A >> shamt);
-				break;
-			}
-			case Function::XOR:
-				++(i->cycle);
-				i->result = i->Vj ^ i->Vk;
-				break;
-			case Function::OR:
-				++(i->cycle);
-				i->result = i->Vj | i->Vk;
-				break;
-			case Function::AND:
-				++(i->cycle);
-				i->result = i->Vj & i->Vk;
-				break;
-			case Function::SLT:
-				++(i->cycle);
-				i->result = int32_t(i->Vj < i->Vk);
-				break;
-			case Function::SLTU:
-				++(i->cycle);
-				i->result = int32_t(uint32_t(i->Vj) < uint32_t(i->Vk));
-				break;
+	uint32_t selected[MAX_RS_ENTRIES];
+	uint32_t n = ALU_RS.select(selected, dispatch_slots);
+	dispatch_slots -= n;
+	for (uint32_t s = 0; s < n; ++s)
+		ALU_RS.start(selected[s]);
+
+	for (uint64_t m = ALU_RS.started_slots(); m != 0; m &= m - 1) {
+		RS_ENTRY* i = &ALU_RS[first_slot(m)];
+		switch (i->function)
+		{
+		case Function::ADD:
+			++(i->cycle);
+			i->result = i->Vj + i->Vk;
+			break;
+		case Function::SUB:
+			++(i->cycle);
+			i->result = i->Vj - i->Vk;
+			break;
+		case Function::SLL: {
+			++(i->cycle);
+			uint8_t shamt = i->Vk & 0x1f;
+			i->result = (i->Vj << shamt);
+			break;
+		}
+		case Function::SRA: {
+			++(i->cycle);
+			uint8_t shamt = i->Vk & 0x1f;
+			i->result = (i->Vj >> shamt);
+			break;
+		}
+		case Function::SRL: {
+			++(i->cycle);
+			uint8_t shamt = i->Vk & 0x1f;
+			uint32_t A = uint32_t(i->Vj);
+			i->result = uint32_t(A >> shamt);
+			break;
+		}
+		case Function::XOR:
+			++(i->cycle);
+			i->result = i->Vj ^ i->Vk;
+			break;
+		case Function::OR:
+			++(i->cycle);
+			i->result = i->Vj | i->Vk;
+			break;
+		case Function::AND:
+			++(i->cycle);
+			i->result = i->Vj & i->Vk;
+			break;
+		case Function::SLT:
+			++(i->cycle);
+			i->result = int32_t(i->Vj < i->Vk);
+			break;
+		case Function::SLTU:
+			++(i->cycle);
+			i->result = int32_t(uint32_t(i->Vj) < uint32_t(i->Vk));
+			break;
 
-			case Function::ADDI:
-				++(i->cycle);
-				i->result = i->Vj + int32_t(i->Vk);
-				break;
-			case Function::XORI:
-				++(i->cycle);
-				i->result = i->Vj ^ int32_t(i->Vk);
-				break;
-			case Function::ORI:
-				++(i->cycle);
-				i->result = i->Vj | int32_t(i->Vk);
-				break;
-			case Function::ANDI:
-				++(i->cycle);
-				i->result = i->Vj & int32_t(i->Vk);
-				break;
-			case Function::SLLI:
-				++(i->cycle);
-				i->result = (i->Vj << i->Vk);
-				break;
-			case Function::SRLI: {
-				++(i->cycle);
-				uint32_t A = uint32_t(i->Vj);
-				i->result = uint32_t(A >> i->Vk);
-				break;
-			}
-			case Function::SRAI:
-				++(i->cycle);
-				i->result = (i->Vj >> i->Vk);
-				break;
-			case Function::SLTI:
-				++(i->cycle);
-				i->result = int32_t(i->Vj < int32_t(i->Vk));
-				break;
-			case Function::SLTIU:
-				++(i->cycle);
-				i->result = int32_t(uint32_t(i->Vj) < i->Vk);
-				break;
+		case Function::ADDI:
+			++(i->cycle);
+			i->result = i->Vj + int32_t(i->Vk);
+			break;
+		case Function::XORI:
+			++(i->cycle);
+			i->result = i->Vj ^ int32_t(i->Vk);
+			break;
+		case Function::ORI:
+			++(i->cycle);
+			i->result = i->Vj | int32_t(i->Vk);
+			break;
+		case Function::ANDI:
+			++(i->cycle);
+			i->result = i->Vj & int32_t(i->Vk);
+			break;
+		case Function::SLLI:
+			++(i->cycle);
+			i->result = (i->Vj << i->Vk);
+			break;
+		case Function::SRLI: {
+			++(i->cycle);
+			uint32_t A = uint32_t(i->Vj);
+			i->result = uint32_t(A >> i->Vk);
+			break;
+		}
+		case Function::SRAI:
+			++(i->cycle);
+			i->result = (i->Vj >> i->Vk);
+			break;
+		case Function::SLTI:
+			++(i->cycle);
+			i->result = int32_t(i->Vj < int32_t(i->Vk));
+			break;
+		case Function::SLTIU:
+			++(i->cycle);
+			i->result = int32_t(uint32_t(i->Vj) < i->Vk);
+			break;
 
-			case Function::BEQ:
-				++(i->cycle);
-				i->result = int32_t(i->Vj == i->Vk);
-				break;
-			case Function::BNE:
-				++(i->cycle);
-				i->result = int32_t(i->Vj != i->Vk);
-				break;
-			case Function::BLT:
-				++(i->cycle);
-				i->result = int32_t(i->Vj < i->Vk);
-				break;
-			case Function::BGE:
-				++(i->cycle);
-				i->result = int32_t(i->Vj >= i->Vk);
-				break;
-			case Function::BLTU:
-				++(i->cycle);
-				i->result = int32_t(uint32_t(i->Vj) < uint32_t(i->Vk));
-				break;
-			case Function::BGEU:
-				++(i->cycle);
-				i->result = int32_t(uint32_t(i->Vj) >= uint32_t(i->Vk));
-				break;
+		case Function::BEQ:
+			++(i->cycle);
+			i->result = int32_t(i->Vj == i->Vk);
+			break;
+		case Function::BNE:
+			++(i->cycle);
+			i->result = int32_t(i->Vj != i->Vk);
+			break;
+		case Function::BLT:
+			++(i->cycle);
+			i->result = int32_t(i->Vj < i->Vk);
+			break;
+		case Function::BGE:
+			++(i->cycle);
+			i->result = int32_t(i->Vj >= i->Vk);
+			break;
+		case Function::BLTU:
+			++(i->cycle);
+			i->result = int32_t(uint32_t(i->Vj) < uint32_t(i->Vk));
+			break;
+		case Function::BGEU:
+			++(i->cycle);
+			i->result = int32_t(uint32_t(i->Vj) >= uint32_t(i->Vk));
+			break;
 
-			default:
-				++(i->cycle);
-				i->result = i->Vj + i->Vk;
-				break;
-			}
+		case Function::JALR:
+			++(i->cycle);
+			i->result = int32_t(i->A);
+			break;
+
+		default:
+			++(i->cycle);
+			i->result = i->Vj + i->Vk;
+			break;
 		}
-		++i;
 	}
 
 	return Stage_Result::EX;
@@ -419,179 +868,268 @@ Stage_Result Tomasulo::execute_muldiv()
 	if (MULDIV_RS.empty())
 		return Stage_Result::NOP;
 
-	std::list<RS_ENTRY>::iterator i = MULDIV_RS.begin();
-	while (i != MULDIV_RS.end())
-	{
-		if (i->Qj == 0 && i->Qk == 0) {
-			switch (i->function)
-			{
-			case Function::MUL: {
-				if (++(i->cycle) >= MUL_CYCLE) {
-					int64_t out = (i->Vj) * (i->Vk);
-					int32_t low = out & 0xFFFFFFFF;
-					i->result = low;
-				}
-				break;
-			}
-			case Function::MULH: {
-				if (++(i->cycle) >= MUL_CYCLE) {
-					int64_t out = int64_t(i->Vj) * int64_t(i->Vk);
-					int32_t high = (out & 0xFFFFFFFF00000000) >> 32;
-					i->result = high;
-				}
-				break;
-			}
-			case Function::MULHSU: {
-				if (++(i->cycle) >= MUL_CYCLE) {
-					int64_t out = int64_t(i->Vj) * uint64_t(i->Vk);
-					int32_t high = (out & 0xFFFFFFFF00000000) >> 32;
-					i->result = high;
-				}
-				break;
-			}
-			case Function::MULHU: {
-				if (++(i->cycle) >= MUL_CYCLE) {
-					uint64_t out = uint64_t(i->Vj) * uint64_t(i->Vk);
-					int32_t high = (out & 0xFFFFFFFF00000000) >> 32;
-					i->result = high;
-				}
-				break;
-			}
-			case Function::DIV: {
-				if (++(i->cycle) >= DIV_CYCLE) {
-					i->result = i->Vj / i->Vk;
-				}
-				break;
-			}
-			case Function::DIVU: {
-				if (++(i->cycle) >= DIV_CYCLE) {
-					i->result = uint32_t(i->Vj) / uint32_t(i->Vk);
-				}
-				break;
-			}
-			case Function::REM: {
-				if (++(i->cycle) >= DIV_CYCLE) {
-					i->result = i->Vj % i->Vk;
-
-				}
-				break;
-			}
-			case Function::REMU: {
-				if (++(i->cycle) >= DIV_CYCLE) {
-					i->result = uint32_t(i->Vj) % uint32_t(i->Vk);
-				}
-				break;
-			}
-			}
-			
-		}
-		++i;
-		
+	uint32_t selected[MAX_RS_ENTRIES];
+	uint32_t n = MULDIV_RS.select(selected, dispatch_slots);
+	dispatch_slots -= n;
+	for (uint32_t s = 0; s < n; ++s)
+		MULDIV_RS.start(selected[s]);
+
+	for (uint64_t m = MULDIV_RS.started_slots(); m != 0; m &= m - 1) {
+		RS_ENTRY* i = &MULDIV_RS[first_slot(m)];
+		uint32_t latency = rv32m_is_div(i->function) ? DIV_CYCLE : MUL_CYCLE;
+		if (++(i->cycle) >= latency)
+			i->result = rv32m(i->function, i->Vj, i->Vk);
 	}
 
 	
 	return Stage_Result::MULDIV;
 }
 
+Stage_Result Tomasulo::execute_fp()
+{
+	if (FP_RS.empty())
+		return Stage_Result::NOP;
+
+	uint32_t selected[MAX_RS_ENTRIES];
+	uint32_t n = FP_RS.select(selected, dispatch_slots);
+	dispatch_slots -= n;
+	for (uint32_t s = 0; s < n; ++s) {
+		RS_ENTRY* i = &FP_RS[selected[s]];
+		switch (i->function)
+		{
+		case Function::FADD_S:
+			i->latency = FP_ADD_CYCLE;
+			i->result = as_bits(as_float(i->Vj) + as_float(i->Vk));
+			break;
+		case Function::FSUB_S:
+			i->latency = FP_ADD_CYCLE;
+			i->result = as_bits(as_float(i->Vj) - as_float(i->Vk));
+			break;
+		case Function::FMUL_S:
+			i->latency = FP_MUL_CYCLE;
+			i->result = as_bits(as_float(i->Vj) * as_float(i->Vk));
+			break;
+		case Function::FDIV_S:
+			i->latency = FP_DIV_CYCLE;
+			i->result = as_bits(as_float(i->Vj) / as_float(i->Vk));
+			break;
+		default:
+			std::clog << "Invalid FP operation" << std::endl;
+			exit(1);
+		}
+		FP_RS.start(selected[s]);
+	}
+
+	// a new operation enters each unit every cycle
+	for (uint64_t m = FP_RS.started_slots(); m != 0; m &= m - 1) {
+		RS_ENTRY* i = &FP_RS[first_slot(m)];
+		if (i->cycle < i->latency)
+			++(i->cycle);
+	}
+
+	return Stage_Result::EX;
+}
+
+static uint32_t access_size(Function func)
+{
+	switch (func)
+	{
+	case Function::LB:
+	case Function::LBU:
+	case Function::SB:
+		return BYTE_SIZE;
+	case Function::LH:
+	case Function::LHU:
+	case Function::SH:
+		return HALFWORD_SIZE;
+	default:
+		return WORD_SIZE;
+	}
+}
+
 Stage_Result Tomasulo::execute_addr_unit()
 {
 	if (ADDR_RS.empty())
 		return Stage_Result::NOP;
 
-	std::list<RS_ENTRY>::iterator i = ADDR_RS.begin();
-	while (i != ADDR_RS.end()) {
-		if (i->Qj == 0 && i->Qk == 0) {
-			switch (i->opcode)
-			{
-			case Opcode::LOAD: {
+	uint32_t selected[MAX_RS_ENTRIES];
+	uint32_t n = ADDR_RS.select(selected, dispatch_slots);
+	dispatch_slots -= n;
+	for (uint32_t s = 0; s < n; ++s) {
+		RS_ENTRY* i = &ADDR_RS[selected[s]];
+		switch (i->opcode)
+		{
+		case Opcode::LOAD:
+		case Opcode::LOAD_FP: {
+			RS_ENTRY rs;
+			rs.function = i->function;
+			rs.opcode = i->opcode;
+			rs.in_use = true;
+			rs.Vj = 0; rs.Vk = 0;
+			rs.Qj = 0; rs.Qk = 0;
+			rs.dest = i->dest;
+			rs.A = i->A + i->Vj;
+
+			caches->train(ROB_queue[rs.dest].insn.fields.pc, rs.A);
+			ROB_queue[rs.dest].addr = rs.A;
+			LOAD_BUFFER.claim(rs);
+			ROB_queue[rs.dest].load_reserved = false;
+			break;
+		}
+		case Opcode::STORE:
+		case Opcode::STORE_FP: {
+			ROB_ENTRY* b = &ROB_queue[i->dest];
+			b->addr = i->A + i->Vj;
+			b->ready_addr = true;
+			SQ.resolve(b->sq_seq, b->addr, access_size(b->insn.function));
+			caches->train(b->insn.fields.pc, b->addr);
+			check_violation(i->dest);
+			break;
+		}
+		case Opcode::AMO: {
+			ROB_ENTRY* b = &ROB_queue[i->dest];
+			b->addr = i->Vj;
+			b->ready_addr = true;
+			if (i->function != Function::LR_W) {
+				SQ.resolve(b->sq_seq, b->addr, WORD_SIZE);
+				check_violation(i->dest);
+			}
+
+			if (i->function != Function::SC_W) {
 				RS_ENTRY rs;
 				rs.function = i->function;
 				rs.opcode = i->opcode;
 				rs.in_use = true;
-				rs.Vj = 0; rs.Vk = 0;
-				rs.Qj = 0; rs.Qk = 0;
+
+				rs.Vj = 0; rs.Qj = 0;
+				rs.Vk = i->Vk; rs.Qk = 0;
+
 				rs.dest = i->dest;
-				rs.A = i->A + i->Vj;
+				rs.A = i->Vj;
 
-				LOAD_BUFFER.emplace_back(rs);
-				break;
+				LOAD_BUFFER.claim(rs);
+				b->load_reserved = false;
 			}
-			case Opcode::STORE:{
-				ROB_ENTRY* b = (ROB_ENTRY*)(i->dest);
-				b->addr = i->A + i->Vj;
-				b->ready_addr = true;
+			break;
+		}
+		}
 
-				
-				break;
-			}
-			case Opcode::AMO: {
-				ROB_ENTRY* b = (ROB_ENTRY*)(i->dest);
-				b->addr = i->Vj;
-				b->ready_addr = true;
+		ADDR_RS.remove(selected[s]);
+	}
 
-				if (i->function != Function::SC_W) {
-					RS_ENTRY rs;
-					rs.function = i->function;
-					rs.opcode = i->opcode;
-					rs.in_use = true;
+	if (violated != 0) {
+		replay(violated);
+		violated = 0;
+	}
 
-					rs.Vj = 0; rs.Qj = 0;
-					rs.Vk = i->Vk; rs.Qk = 0;
+	return Stage_Result::ADDR;
+}
 
-					rs.dest = i->dest;
-					rs.A = i->Vj;
+static int32_t extend(Function func, uint32_t raw)
+{
+	switch (func)
+	{
+	case Function::LB:
+		return int8_t(raw);
+	case Function::LH:
+		return int16_t(raw);
+	case Function::LBU:
+		return uint8_t(raw);
+	case Function::LHU:
+		return uint16_t(raw);
+	default:
+		return int32_t(raw);
+	}
+}
 
-					LOAD_BUFFER.emplace_back(rs);
-				}
+bool Tomasulo::find_mem_value_in_SQ(uint32_t start_el, uint32_t addr, bool & valid, int32_t& value, bool& speculative)
+{
+	ROB_ENTRY& load = ROB_queue[start_el];
+	uint32_t size = access_size(load.insn.function);
+	speculative = false;
+
+	// per byte, the youngest older store that writes it
+	SQ.older(addr, size, load.sq_end, store_matches);
+	const StoreMatch* source[WORD_SIZE] = { nullptr };
+	bool covered = true;
+	unsigned long long oldest = load.sq_end;
+	uint32_t oldest_rob = 0;
+	for (uint32_t k = 0; k < size; ++k) {
+		for (const StoreMatch& m : store_matches) {
+			if (m.addr <= addr + k && addr + k < m.addr + m.size) {
+				source[k] = &m;
 				break;
 			}
-			}
-			
-			i = ADDR_RS.erase(i);
 		}
-		else
-			++i;
+		if (source[k] == nullptr)
+			covered = false;
+		else if (source[k]->seq < oldest) {
+			oldest = source[k]->seq;
+			oldest_rob = source[k]->rob;
+		}
 	}
 
-	return Stage_Result::ADDR;
+	// a store with an unknown address younger than the bytes' sources may
+	// still write them; plain loads go past it unless the store sets
+	// predict a conflict
+	if (SQ.unresolved_in(covered ? oldest : SQ.front(), load.sq_end)) {
+		bool speculate = store_sets && is_load(load.insn.opcode);
+		uint32_t dep = load.store_dep;
+		if (speculate && dep != 0 && ROB_queue.contains(dep)
+			&& ROB_queue.position_of(dep) < ROB_queue.position_of(start_el) && !ROB_queue[dep].ready_addr)
+			speculate = false;
+		if (!speculate) {
+			valid = false;
+			return true;
+		}
+		speculative = true;
+	}
+	if (store_matches.empty())
+		return false;
+
+	// stores write memory at commit, so the other bytes are current
+	uint32_t raw = covered ? 0 : uint32_t(memory->read_int(addr, size, false));
+	for (uint32_t k = 0; k < size; ++k) {
+		if (source[k] == nullptr)
+			continue;
+		ROB_ENTRY& st = ROB_queue[source[k]->rob];
+		if (!st.ready_value) {
+			valid = false;
+			return true;
+		}
+		uint32_t byte = (uint32_t(st.mem_value) >> (8 * (addr + k - source[k]->addr))) & 0xff;
+		raw = (raw & ~(0xffu << (8 * k))) | (byte << (8 * k));
+	}
+	value = extend(load.insn.function, raw);
+	valid = true;
+	load.forwarded_from = covered ? oldest_rob : 0;
+	return true;
 }
 
-bool Tomasulo::find_mem_value_in_ROB(uint32_t start_el, uint32_t addr, bool & valid, int32_t& value)
+void Tomasulo::check_violation(uint32_t store)
 {
-	ROB_ENTRY* start_point = (ROB_ENTRY*)(start_el);
-	std::list<ROB_ENTRY>::reverse_iterator it = ROB_queue.rbegin();
-	while (it != ROB_queue.rend()) {
-		if (start_point == &(*it)) {
-			++it;
-			while (it != ROB_queue.rend()) {
-				if (it->insn.opcode == Opcode::STORE
-					||(it->insn.opcode == Opcode::AMO && 
-						it->insn.function != Function::LR_W)) {
-					if (it->ready_addr) {
-						if (addr == it->addr) {
-							if (it->ready_value) {
-								value = it->mem_value;
-								valid = true;
-								return true;
-							}
-							else {
-								valid = false;
-								return true;
-							}
-						}
-					}
-					else {
-						valid = false;
-						return true;
-					}
-				}
-				++it;
-			}
-			break;
-		}
-		++it;
+	if (!store_sets)
+		return;
+	ROB_ENTRY& st = ROB_queue[store];
+	uint32_t position = ROB_queue.position_of(store);
+	uint32_t size = access_size(st.insn.function);
+	for (uint32_t n = position + 1; n < ROB_queue.size(); ++n) {
+		uint32_t tag = ROB_queue.tag_at(n);
+		ROB_ENTRY& ld = ROB_queue[tag];
+		if (!is_load(ld.insn.opcode) || !ld.load_issued
+			|| st.addr >= ld.addr + access_size(ld.insn.function) || ld.addr >= st.addr + size)
+			continue;
+		// a store between the two supplied the value
+		if (ld.forwarded_from != 0 && ROB_queue.contains(ld.forwarded_from)
+			&& ROB_queue.position_of(ld.forwarded_from) > position
+			&& ROB_queue.position_of(ld.forwarded_from) < n)
+			continue;
+		store_sets->violation(st.insn.fields.pc, ld.insn.fields.pc);
+		// younger loads go with the oldest one
+		if (violated == 0 || n < ROB_queue.position_of(violated))
+			violated = tag;
+		return;
 	}
-	return false;
 }
 
 // return mem_value
@@ -604,7 +1142,7 @@ int32_t Tomasulo::amo(Function func, int32_t load_value, int32_t src)
 		return 0;
 	}
 	case Function::AMOSWAP_W: {
-		
+
 		int32_t result = src;
 		return result;
 	}
@@ -694,95 +1232,119 @@ void Tomasulo::write_memory(Function func, int32_t addr, int32_t value)
 Stage_Result Tomasulo::execute_memory_unit()
 {
 	// check the load buffer
-	bool load{ true };
-	if (LOAD_BUFFER.empty()) load = false;
-
-	std::list<RS_ENTRY>::iterator i = LOAD_BUFFER.begin();
-	while (i != LOAD_BUFFER.end()) {
-		if (i->Qj == 0 && i->Qk == 0) {
-			if (i->cycle == 0) {
-				// check ROB
-				bool valid = false;
-				int32_t value = 0;
-				bool result = find_mem_value_in_ROB(i->dest, i->A, valid, value);
-				if (result) {
-					if (valid) {
-						i->result = value;
-						if (i->opcode == Opcode::AMO) {
-							ROB_ENTRY* b = (ROB_ENTRY*)(i->dest);
-							b->mem_value = amo(i->function, value, i->Vk);
-							b->ready_value = true;
-						}
-						i->cycle = CACHE_ACCESS_CYCLE;
-					}
-				}
-				else {
-					++(i->cycle);
-				}
-			}
-			else if (i->cycle < CACHE_ACCESS_CYCLE) {
-				if (++(i->cycle) == CACHE_ACCESS_CYCLE) {
-					i->result = read_memory(i->function, i->A);
+	// oldest first, so older loads claim the MSHRs and the ports
+	uint32_t ports = LOAD_BUFFER.units() < dispatch_slots ? LOAD_BUFFER.units() : dispatch_slots;
+	uint32_t order[MAX_RS_ENTRIES];
+	uint32_t n = LOAD_BUFFER.by_age(LOAD_BUFFER.busy_slots(), order);
+	for (uint32_t s = 0; s < n; ++s) {
+		RS_ENTRY* i = &LOAD_BUFFER[order[s]];
+		bool start = false;
+		if (i->cycle == 0 && ports > 0) {
+			// check ROB
+			bool valid = false;
+			int32_t value = 0;
+			bool speculative = false;
+			bool result = find_mem_value_in_SQ(i->dest, i->A, valid, value, speculative);
+			if (result) {
+				if (valid) {
+					--ports;
+					ROB_queue[i->dest].load_issued = true;
+					if (speculative)
+						++store_sets->speculative;
+					i->result = value;
 					if (i->opcode == Opcode::AMO) {
-						ROB_ENTRY* b = (ROB_ENTRY*)(i->dest);
-						b->mem_value = amo(i->function, i->result, i->Vk);
+						ROB_ENTRY* b = &ROB_queue[i->dest];
+						b->mem_value = amo(i->function, value, i->Vk);
 						b->ready_value = true;
 					}
+					i->cycle = i->latency = 1;
+				}
+			}
+			else if (caches->load(i->A, i->latency)) {
+				--ports;
+				ROB_queue[i->dest].load_issued = true;
+				if (speculative)
+					++store_sets->speculative;
+				start = true;
+			}
+		}
+		if (start || (i->cycle != 0 && i->cycle < i->latency)) {
+			if (++(i->cycle) == i->latency) {
+				i->result = read_memory(i->function, i->A);
+				if (i->opcode == Opcode::AMO) {
+					ROB_ENTRY* b = &ROB_queue[i->dest];
+					b->mem_value = amo(i->function, i->result, i->Vk);
+					b->ready_value = true;
 				}
 			}
-			
 		}
-		++i;
 	}
 
 	// check ROB
-	if (ROB_queue.front().insn.opcode == Opcode::STORE
+	if (!ROB_queue.empty() && (is_store(ROB_queue.front().insn.opcode)
 		|| (ROB_queue.front().insn.opcode == Opcode::AMO
-			&& ROB_queue.front().insn.function != Function::LR_W)) {
+			&& ROB_queue.front().insn.function != Function::LR_W))) {
 		if (ROB_queue.front().ready_addr && ROB_queue.front().ready_value) {
-			if (++(ROB_queue.front().cycle) == 1) {
+			ROB_ENTRY& head = ROB_queue.front();
+			if (head.cycle == 0)
+				head.latency = caches->store(head.addr);
+			if (++(head.cycle) == head.latency) {
 				write_memory(ROB_queue.front().insn.function,
 					ROB_queue.front().addr, ROB_queue.front().mem_value);
                 if(ROB_queue.front().insn.function == Function::SC_W){
-                      RS_ENTRY rs;
-                      fill_RSentry(ROB_queue.front().insn, rs, uint32_t(&ROB_queue.front()));
-                      rs.result = 0;
-                      rs.cycle = CACHE_ACCESS_CYCLE;
-                      LOAD_BUFFER.emplace_back(rs);
-			    }
-		    }
-	    }
-    }
+                    RS_ENTRY rs;
+                    fill_RSentry(ROB_queue.front().insn, rs, ROB_queue.front_tag());
+                    rs.result = 0;
+                    rs.cycle = rs.latency = 1;
+                    LOAD_BUFFER.claim(rs);
+                    head.load_reserved = false;
+                }
+			}
+		}
+	}
 
 	return Stage_Result::MEM;
 }
 
 void Tomasulo::get_ALU_RS_completion(std::list<CDB_ENTRY>& cdb)
 {
-	std::list<RS_ENTRY>::iterator it = ALU_RS.begin();
-	while (it != ALU_RS.end()) {
+	for (uint64_t m = ALU_RS.started_slots(); m != 0; m &= m - 1) {
+		uint32_t slot = first_slot(m);
+		RS_ENTRY* it = &ALU_RS[slot];
 		if (it->cycle >= 1) {
-			ROB_ENTRY* b = (ROB_ENTRY*)(it->dest);
+			ROB_ENTRY* b = &ROB_queue[it->dest];
+			bool result = b->rd != 0 && b->insn.function != Function::ECALL;
+			if (result && cdb.size() >= core.cdb_width) {
+				++cdb_stalls;
+				continue;
+			}
 			if(b->insn.function != Function::ECALL)
 				b->complete = true;
             else
                 b->ready_value = true;
 			b->value = it->result;
-			if (b->rd != 0 && b->insn.function != Function::ECALL) {
+			if (b->insn.opcode == Opcode::JALR)
+				b->addr = uint32_t(it->Vj + it->Vk) & 0xfffffffe;
+			// resolve at execute, the oldest mispredict of the cycle wins
+			bool wrong = b->insn.opcode == Opcode::BRANCH ? (it->result > 0) != b->insn.taken
+				: b->insn.opcode == Opcode::JALR && b->addr != b->insn.next_pc;
+			if (wrong && (mispredicted == 0
+				|| ROB_queue.position_of(it->dest) < ROB_queue.position_of(mispredicted)))
+				mispredicted = it->dest;
+			if (result) {
 				cdb.emplace_back( it->dest, it->result );
 			}
 
-			it = ALU_RS.erase(it);
+			ALU_RS.remove(slot);
 		}
-		else
-			++it;
 	}
 }
 
 void Tomasulo::get_MULDIV_RS_completion(std::list<CDB_ENTRY>& cdb)
 {
-	std::list<RS_ENTRY>::iterator it = MULDIV_RS.begin();
-	while (it != MULDIV_RS.end()) {
+	for (uint64_t m = MULDIV_RS.started_slots(); m != 0; m &= m - 1) {
+		uint32_t slot = first_slot(m);
+		RS_ENTRY* it = &MULDIV_RS[slot];
 	    bool erase{ false };
 		switch (it->function)
 		{
@@ -791,7 +1353,11 @@ void Tomasulo::get_MULDIV_RS_completion(std::list<CDB_ENTRY>& cdb)
 		case Function::MULHSU:
 		case Function::MULHU: {
 			if ((it->cycle) >= MUL_CYCLE) {
-				ROB_ENTRY* b = (ROB_ENTRY*)(it->dest);
+				ROB_ENTRY* b = &ROB_queue[it->dest];
+				if (b->rd != 0 && cdb.size() >= core.cdb_width) {
+					++cdb_stalls;
+					break;
+				}
 				b->complete = true;
 				b->value = it->result;
 				if (b->rd != 0) {
@@ -806,7 +1372,11 @@ void Tomasulo::get_MULDIV_RS_completion(std::list<CDB_ENTRY>& cdb)
 		case Function::REM:
 		case Function::REMU: {
 			if ((it->cycle) >= DIV_CYCLE) {
-				ROB_ENTRY* b = (ROB_ENTRY*)(it->dest);
+				ROB_ENTRY* b = &ROB_queue[it->dest];
+				if (b->rd != 0 && cdb.size() >= core.cdb_width) {
+					++cdb_stalls;
+					break;
+				}
 				b->complete = true;
 				b->value = it->result;
 				if (b->rd != 0) {
@@ -817,86 +1387,69 @@ void Tomasulo::get_MULDIV_RS_completion(std::list<CDB_ENTRY>& cdb)
 			break;
 		}
 		}
-		if (erase) it = MULDIV_RS.erase(it);
-		else ++it;
+		if (erase) MULDIV_RS.remove(slot);
 	}
 			
 }
 
+void Tomasulo::get_FP_RS_completion(std::list<CDB_ENTRY>& cdb)
+{
+	for (uint64_t m = FP_RS.started_slots(); m != 0; m &= m - 1) {
+		uint32_t slot = first_slot(m);
+		RS_ENTRY* it = &FP_RS[slot];
+		if (it->cycle >= it->latency) {
+			if (cdb.size() >= core.cdb_width) {
+				++cdb_stalls;
+				continue;
+			}
+			ROB_ENTRY* b = &ROB_queue[it->dest];
+			b->complete = true;
+			b->value = it->result;
+			cdb.emplace_back(it->dest, it->result);
+
+			FP_RS.remove(slot);
+		}
+	}
+}
+
 void Tomasulo::get_LOAD_BUFFER_completion(std::list<CDB_ENTRY>& cdb)
 {
-	std::list<RS_ENTRY>::iterator it = LOAD_BUFFER.begin();
-	while (it != LOAD_BUFFER.end()) {
-		if (it->cycle >= CACHE_ACCESS_CYCLE) {
-			ROB_ENTRY* b = (ROB_ENTRY*)(it->dest);
+	for (uint64_t m = LOAD_BUFFER.busy_slots(); m != 0; m &= m - 1) {
+		uint32_t slot = first_slot(m);
+		RS_ENTRY* it = &LOAD_BUFFER[slot];
+		if (it->latency != 0 && it->cycle >= it->latency) {
+			ROB_ENTRY* b = &ROB_queue[it->dest];
+			if (b->rd != 0 && cdb.size() >= core.cdb_width) {
+				++cdb_stalls;
+				continue;
+			}
 			b->complete = true;
 			b->value = it->result;
 			if (b->rd != 0) {
 				cdb.emplace_back(it->dest, it->result);
 			}
 
-			it = LOAD_BUFFER.erase(it);
+			LOAD_BUFFER.remove(slot);
 		}
-		else
-			++it;
 	}
 }
 
 void Tomasulo::broadcast(CDB_ENTRY cdb)
 {
-	// ALU_RS
-	std::list<RS_ENTRY>::iterator it = ALU_RS.begin();
-	while (it != ALU_RS.end()) {
-		if (it->Qj == cdb.nROB) {
-			it->Vj = cdb.value;
-			it->Qj = 0;
-		}
-		if (it->Qk == cdb.nROB) {
-			it->Vk = cdb.value;
-			it->Qk = 0;
-		}
-	
-		++it;
-	}
-	// MULDIV
-	it = MULDIV_RS.begin();
-	while (it != MULDIV_RS.end()) {
-		if (it->Qj == cdb.nROB) {
-			it->Vj = cdb.value;
-			it->Qj = 0;
-		}
-		if (it->Qk == cdb.nROB) {
-			it->Vk = cdb.value;
-			it->Qk = 0;
-		}
-
-		++it;
-	}
-	// ADDR_RS
-	it = ADDR_RS.begin();
-	while (it != ADDR_RS.end()) {
-		if (it->Qj == cdb.nROB) {
-			it->Vj = cdb.value;
-			it->Qj = 0;
-		}
-		if (it->Qk == cdb.nROB) {
-			it->Vk = cdb.value;
-			it->Qk = 0;
-		}
-
-		++it;
-	}
-	// ROB
-	std::list<ROB_ENTRY>::iterator i = ROB_queue.begin();
-	while (i != ROB_queue.end()) {
-		if (i->src == cdb.nROB
-			&&(i->insn.opcode == Opcode::STORE
-				|| i->insn.function == Function::SC_W)) {
-			i->mem_value = cdb.value;
-			i->src = 0;
-			i->ready_value = true;
-		}
-		++i;
+	if (rename)
+		rename->write(ROB_queue[cdb.nROB].pdest, cdb.value);
+	ALU_RS.wakeup(cdb.nROB, cdb.value);
+	MULDIV_RS.wakeup(cdb.nROB, cdb.value);
+	FP_RS.wakeup(cdb.nROB, cdb.value);
+	ADDR_RS.wakeup(cdb.nROB, cdb.value);
+	// stores waiting for their data
+	uint32_t tag = ROB_queue.take_waiters(cdb.nROB);
+	while (tag != 0) {
+		ROB_ENTRY& i = ROB_queue[tag];
+		i.mem_value = cdb.value;
+		i.src = 0;
+		i.ready_value = true;
+		tag = i.next_waiter;
 	}
 }
 
@@ -905,8 +1458,16 @@ Stage_Result Tomasulo::write_result()
 	std::list<CDB_ENTRY> CDB;
 	get_ALU_RS_completion(CDB);
 	get_MULDIV_RS_completion(CDB);
+	get_FP_RS_completion(CDB);
 	get_LOAD_BUFFER_completion(CDB);
 
+	if (mispredicted != 0) {
+		squash_after(mispredicted);
+		mispredicted = 0;
+		// results of squashed instructions never reach the CDB
+		CDB.remove_if([this](const CDB_ENTRY& c) { return !ROB_queue.contains(c.nROB); });
+	}
+
 	std::list<CDB_ENTRY>::iterator i = CDB.begin();
 	while (i != CDB.end()) {
 		broadcast(*i);
@@ -916,37 +1477,179 @@ Stage_Result Tomasulo::write_result()
 	return Stage_Result::CDB;
 }
 
+void Tomasulo::restore_front_end(const Instruction& insn)
+{
+	if (targets)
+		targets->ras.restore(insn.ras_top, insn.ras_value);
+}
+
+void Tomasulo::discard(uint32_t keep)
+{
+	squashed += ROB_queue.size() - keep + instrunction_queue.size();
+	for (uint32_t n = keep; n < ROB_queue.size(); ++n) {
+		uint32_t tag = ROB_queue.tag_at(n);
+		if (ROB_queue[tag].load_reserved)
+			LOAD_BUFFER.unreserve();
+		if (store_sets)
+			store_sets->forget(ROB_queue[tag].store_set, tag);
+	}
+	if (keep < ROB_queue.size())
+		SQ.truncate(ROB_queue[ROB_queue.tag_at(keep)].sq_end);
+	ROB_queue.truncate(keep);
+
+	ReservationStation* stations[] = { &ALU_RS, &MULDIV_RS, &ADDR_RS, &LOAD_BUFFER, &FP_RS };
+	for (ReservationStation* station : stations) {
+		for (uint64_t m = station->busy_slots(); m != 0; m &= m - 1) {
+			uint32_t slot = first_slot(m);
+			if (!ROB_queue.contains((*station)[slot].dest))
+				station->remove(slot);
+		}
+	}
+
+	if (!rename) {
+		// the youngest surviving writer of each register
+		for (int i = 0; i < LOGICAL_REGS; ++i)
+			register_stat[i].busy = false;
+		for (uint32_t n = 0; n < ROB_queue.size(); ++n) {
+			uint32_t t = ROB_queue.tag_at(n);
+			if (ROB_queue[t].rd != 0) {
+				register_stat[ROB_queue[t].rd].busy = true;
+				register_stat[ROB_queue[t].rd].nROB = t;
+			}
+		}
+	}
+
+	redirect_stall = 0;
+	FTQ.clear();
+	instrunction_queue.clear();
+}
+
+void Tomasulo::squash_after(uint32_t tag)
+{
+	ROB_ENTRY& b = ROB_queue[tag];
+	++squashes;
+	discard(ROB_queue.position_of(tag) + 1);
+	if (rename)
+		rename->restore(b.rat_checkpoint);
+
+	if (b.insn.opcode == Opcode::BRANCH) {
+		bool taken = b.value > 0;
+		if (predictor)
+			predictor->repair(b.insn.checkpoint, taken);
+		register_file.pc = taken ? b.insn.fields.pc + b.insn.fields.imm : b.insn.fields.pc + WORD_SIZE;
+	}
+	else {
+		if (predictor)
+			predictor->restore(b.insn.checkpoint);
+		register_file.pc = b.addr;
+	}
+	restore_front_end(b.insn);
+}
+
+static bool is_control(const Instruction& insn)
+{
+	return insn.opcode == Opcode::BRANCH || insn.opcode == Opcode::JALR;
+}
+
+void Tomasulo::replay(uint32_t tag)
+{
+	uint32_t keep = ROB_queue.position_of(tag);
+	Instruction load = ROB_queue[tag].insn;
+
+	// the history as the load was fetched is the checkpoint of the first
+	// branch fetched after it
+	const Instruction* branch = nullptr;
+	for (uint32_t n = keep; n < ROB_queue.size() && !branch; ++n) {
+		if (is_control(ROB_queue[ROB_queue.tag_at(n)].insn))
+			branch = &ROB_queue[ROB_queue.tag_at(n)].insn;
+	}
+	for (uint32_t n = 0; n < instrunction_queue.size() && !branch; ++n) {
+		if (is_control(instrunction_queue[n]))
+			branch = &instrunction_queue[n];
+	}
+	for (uint32_t n = 0; n < FTQ.size() && !branch; ++n) {
+		for (uint32_t k = FTQ[n].consumed; k < FTQ[n].insns.size() && !branch; ++k) {
+			if (is_control(FTQ[n].insns[k]))
+				branch = &FTQ[n].insns[k];
+		}
+	}
+	if (predictor && branch)
+		predictor->restore(branch->checkpoint);
+
+	// no checkpoint at a load, so the renames are walked back youngest first
+	if (rename) {
+		for (uint32_t n = ROB_queue.size(); n-- > keep; ) {
+			ROB_ENTRY& e = ROB_queue[ROB_queue.tag_at(n)];
+			if (e.rd != 0)
+				rename->undo(e.rd, e.pold);
+			if (is_control(e.insn))
+				rename->drop();
+		}
+	}
+	discard(keep);
+	restore_front_end(load);
+	register_file.pc = load.fields.pc;
+}
+
 void Tomasulo::ROB_clear()
 {
+	redirect_stall = 0;
+	FTQ.clear();
 	instrunction_queue.clear();
 	ALU_RS.clear();
 	MULDIV_RS.clear();
 	ADDR_RS.clear();
 	LOAD_BUFFER.clear();
+	FP_RS.clear();
+	SQ.clear();
 	ROB_queue.clear();
-	for (int i = 0; i < 32; ++i)
+	for (int i = 0; i < LOGICAL_REGS; ++i)
 		register_stat[i].busy = false;
+	if (predictor)
+		predictor->recover();
+	if (store_sets)
+		store_sets->flush();
+}
+
+void Tomasulo::retire_rd(const ROB_ENTRY& b)
+{
+	if (b.rd == 0)
+		return;
+	if (rename) {
+		rename->commit(b.rd, b.pdest, b.pold);
+		return;
+	}
+	if (b.rd >= FP_REG_BASE)
+		register_file.fpr[b.rd - FP_REG_BASE] = as_float(b.value);
+	else
+		register_file.gpr[b.rd] = b.value;
+	if (register_stat[b.rd].nROB == ROB_queue.front_tag())
+		register_stat[b.rd].busy = false;
 }
 
 Stage_Result Tomasulo::commit(unsigned long long clock)
 {
-	std::list<ROB_ENTRY>::iterator b = ROB_queue.begin();
 	bool clear = false;
-	while (b != ROB_queue.end()) {
-		if (b->insn.opcode == Opcode::STORE
+	size_t rob_size = ROB_queue.size();
+	size_t occupied = ROB_queue.size();
+	while (!ROB_queue.empty() && occupied - ROB_queue.size() < core.commit_width) {
+		// entries retire in order, so b is always the head
+		ROB_ENTRY* b = &ROB_queue.front();
+		if (is_store(b->insn.opcode)
 			|| (b->insn.opcode == Opcode::AMO
 				&& b->insn.function != Function::LR_W)) {
-			if (b->cycle >= 1 && b->complete) {
-				if (b->rd != 0) {
-					register_file.gpr[b->rd] = b->value;
-					if (register_stat[b->rd].nROB == (uint32_t)(&(*b)))
-						register_stat[b->rd].busy = false;
-				}
-                //std::clog << std::hex << b->insn.fields.pc << std::endl;
-                //for(int i = 0; i < 32; ++i)
-                //    std::clog << " [" << i << "]:" << std::hex << register_file.gpr[i];
-                //std::clog << std::endl;
-				b = ROB_queue.erase(b);
+			if (b->latency != 0 && b->cycle >= b->latency && b->complete) {
+				if (store_sets)
+					store_sets->forget(b->store_set, ROB_queue.front_tag());
+				SQ.pop_front();
+				retire_rd(*b);
+                /*
+                std::clog << std::hex << b->insn.fields.pc << std::endl;
+                for(int i = 0; i < 32; ++i)
+                    std::clog << " [" << i << "]:" << std::hex << register_file.gpr[i];
+                std::clog << std::endl;
+				*/
+                ROB_queue.pop_front();
 			}
 			else
 				break;
@@ -954,17 +1657,31 @@ Stage_Result Tomasulo::commit(unsigned long long clock)
 		else {
 			if (b->insn.function == Function::ECALL) {
                 if(b->ready_value){
+				    // counted before the guest may exit
+				    if (predictor)
+					    predictor->retire(rob_size - ROB_queue.size() + 1);
+				    rob_size = ROB_queue.size() - 1;
+				    if (rename)
+				    	rename->read_architectural(register_file);
 				    handle_syscall(register_file, *memory, clock);
+				    if (rename) {
+				    	rename->commit(b->rd, b->pdest, b->pold);
+				    	rename->write_architectural(register_file);
+				    	rename->recover();
+				    }
 				    //register_file.pc = (b->insn.fields.pc + WORD_SIZE);
 				    register_file.pc = b->value;
 
-				    if (register_stat[b->rd].nROB == (uint32_t)(&(*b)))
+				    if (register_stat[b->rd].nROB == ROB_queue.front_tag())
 					    register_stat[b->rd].busy = false;
-                    //std::clog << std::hex << b->insn.fields.pc << std::endl;
-                    //for(int i = 0; i < 32; ++i)
-                    //    std::clog << " [" << i << "]:" << std::hex << register_file.gpr[i];
-                    //std::clog << std::endl;
-				    b = ROB_queue.erase(b);
+                    /*
+                    std::clog << std::hex << b->insn.fields.pc << std::endl;
+                    for(int i = 0; i < 32; ++i)
+                        std::clog << " [" << i << "]:" << std::hex << register_file.gpr[i];
+                    std::clog << std::endl;
+				    */
+                    restore_front_end(b->insn);
+                    ROB_queue.pop_front();
 				    clear = true;
 				    break;
 			    }
@@ -973,40 +1690,64 @@ Stage_Result Tomasulo::commit(unsigned long long clock)
             }
 
 			if (b->complete == true) {
+				// mispredicts were squashed when the branch executed
 				if (b->insn.opcode == Opcode::BRANCH){
 					bool predict = b->insn.taken;
 					bool result = (b->value > 0)?true:false;
-					if (predict != result) {
-						if (result)
-							register_file.pc = (b->insn.fields.pc + b->insn.fields.imm);
+                    if (predictor)
+                        predictor->update(b->insn.fields.pc, b->insn.checkpoint, result, predict);
+                    if (rename)
+                        rename->release();
+                }
+
+				if (b->insn.opcode == Opcode::JALR) {
+					bool ret = is_return(b->insn);
+					if (targets && ret)
+						++targets->returns;
+					else if (targets) {
+						++targets->indirects;
+						targets->btb.update(b->insn.fields.pc, b->addr);
+					}
+					if (targets && b->addr != b->insn.next_pc) {
+						if (ret)
+							++targets->return_mispredicts;
 						else
-							register_file.pc = (b->insn.fields.pc + WORD_SIZE);
-						clear = true;
-                        //std::clog << std::hex << b->insn.fields.pc << std::endl;
-                        //for(int i = 0; i < 32; ++i)
-                        //    std::clog << " [" << i << "]:" << std::hex << register_file.gpr[i];
-                        //std::clog << std::endl;
-						b = ROB_queue.erase(b);
-						break;
+							++targets->indirect_mispredicts;
 					}
+					if (rename)
+						rename->release();
 				}
-
-				if (b->rd != 0) {
-					register_file.gpr[b->rd] = b->value;
-					if (register_stat[b->rd].nROB == (uint32_t)(&(*b)))
-						register_stat[b->rd].busy = false;
+				else if (targets && b->insn.opcode == Opcode::JAL)
+					targets->btb.update(b->insn.fields.pc, b->insn.fields.pc + b->insn.fields.imm);
+
+				if (b->insn.function == Function::FENCE_I) {
+					// refetch younger instructions from the updated text
+					memory->flush_decode_cache();
+					if (rename)
+						rename->recover();
+					register_file.pc = (b->insn.fields.pc + WORD_SIZE);
+					restore_front_end(b->insn);
+					ROB_queue.pop_front();
+					clear = true;
+					break;
 				}
-                //std::clog << std::hex << b->insn.fields.pc << std::endl;
-                //for(int i = 0; i < 32; ++i)
-                //    std::clog << " [" << i << "]:" << std::hex << register_file.gpr[i];
-                //std::clog << std::endl;
-				b = ROB_queue.erase(b);
+
+				retire_rd(*b);
+                /*
+                std::clog << std::hex << b->insn.fields.pc << std::endl;
+                for(int i = 0; i < 32; ++i)
+                    std::clog << " [" << i << "]:" << std::hex << register_file.gpr[i];
+                std::clog << std::endl;
+				*/
+                ROB_queue.pop_front();
 			}
 			else
 				break;
 		}
 	}
 
+	if (predictor)
+		predictor->retire(rob_size - ROB_queue.size());
 	if (clear) ROB_clear();
 
 	return Stage_Result::COMMIT;
@@ -1018,21 +1759,20 @@ void Tomasulo::run()
 
 	while (true)
 	{
-		int shut_down = 0;
-		uint32_t fetch = 0;
-
 		commit(clock);
 		write_result();
+		dispatch_slots = core.dispatch_width;
 		execute_alu();
 		execute_muldiv();
+		execute_fp();
 		execute_addr_unit();
 		execute_memory_unit();
 		issue();
-		fetch = register_file.pc;
 		fetch_n_decode();
-        //std::clog << std::hex << fetch;
+		predict_fetch_target();
 
 		++clock;
+		caches->tick();
 
 		//for (int i = 0; i < 32; ++i)
 		//	std::clog << " [" << i << "]:" << std::hex << register_file.gpr[i];
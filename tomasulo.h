@@ -3,40 +3,274 @@
 #include "consts.h"
 #include "memory.h"
 #include "registers.h"
+#include "cache.h"
+#include "rename.h"
+#include "branch_predictor.h"
+#include "store_sets.h"
 #include <deque>
 #include <list>
+#include <vector>
+#include <algorithm>
 
 struct RS_ENTRY {
-	Function function;
-	Opcode opcode;
+	Function function{ Function::ADDI };
+	Opcode opcode{ Opcode::OP_IMM };
 	bool in_use{ false };
 
-	int32_t Vj, Vk;
-	uint32_t Qj, Qk;
-	uint32_t dest;		// ROB number
-	uint32_t A;
+	int32_t Vj{ 0 }, Vk{ 0 };
+	uint32_t Qj{ 0 }, Qk{ 0 };
+	uint32_t dest{ 0 };		// ROB number
+	uint32_t A{ 0 };
 
 	uint32_t cycle{ 0 };
-	int32_t result;
+	uint32_t latency{ 0 };
+	int32_t result{ 0 };
 
 };
 
 struct ROB_ENTRY
 {
 	Instruction insn;
-	uint32_t rd, addr;
+	uint32_t rd{ 0 }, addr{ 0 };
 	bool complete{ false };
-	int32_t value;
+	int32_t value{ 0 };
 
-	int32_t mem_value;	// for AMO
+	int32_t mem_value{ 0 };	// for AMO
 	// for STORE
 	bool ready_value{ false }, ready_addr{ false };
 	uint32_t cycle{ 0 };
+	uint32_t latency{ 0 };
 	uint32_t src{ 0 };
+	// next store waiting on the same producer
+	uint32_t next_waiter{ 0 };
+	// physical destination, the mapping it replaces and the RAT checkpoint
+	uint32_t pdest{ 0 }, pold{ 0 };
+	uint32_t rat_checkpoint{ 0 };
+	// holds a load buffer reservation not claimed yet
+	bool load_reserved{ false };
+	// store set + 1 of a store, the store tag a load is predicted to wait for
+	uint32_t store_set{ 0 };
+	uint32_t store_dep{ 0 };
+	// the load has read, and the oldest store that supplied all of its
+	// bytes if no byte came from memory
+	bool load_issued{ false };
+	uint32_t forwarded_from{ 0 };
+	// store queue sequence of a store, and the queue tail at issue
+	unsigned long long sq_seq{ 0 };
+	unsigned long long sq_end{ 0 };
+
+	ROB_ENTRY(const Instruction& insn) : insn(insn) {};
+};
+
+// Fixed-capacity circular reorder buffer. An entry is named by its slot
+// index + 1, so a tag of 0 still means "no producer" in RS_ENTRY::Qj/Qk
+// and REGISTER_STATE::nROB.
+class ReorderBuffer {
+	std::vector<ROB_ENTRY> entries;
+	uint32_t head{ 0 };
+	uint32_t count{ 0 };
+	// per producer tag, the first store waiting for its data
+	std::vector<uint32_t> waiting;
+
+public:
+	ReorderBuffer(uint32_t capacity)
+		: entries(capacity, ROB_ENTRY(Instruction(0))), waiting(capacity + 1) {}
+
+	bool empty() const { return count == 0; }
+	bool full() const { return count == entries.size(); }
+	uint32_t size() const { return count; }
+
+	// tag of the new youngest entry
+	uint32_t push(const Instruction& insn) {
+		uint32_t slot = (head + count) % entries.size();
+		entries[slot] = ROB_ENTRY(insn);
+		++count;
+		return slot + 1;
+	}
+	void pop_front() {
+		head = (head + 1) % entries.size();
+		--count;
+	}
+	void clear() {
+		head = count = 0;
+		std::fill(waiting.begin(), waiting.end(), 0);
+	}
+	uint32_t capacity() const { return entries.size(); }
+	bool contains(uint32_t tag) const { return position_of(tag) < count; }
+	// drops every entry from position keep on, youngest first, and unlinks
+	// the dropped stores from the store data chains of older producers
+	void truncate(uint32_t keep) {
+		while (count > keep) {
+			uint32_t tag = back_tag();
+			ROB_ENTRY& e = back();
+			waiting[tag] = 0;
+			if (e.src != 0 && !e.ready_value && waiting[e.src] == tag)
+				waiting[e.src] = e.next_waiter;
+			--count;
+		}
+	}
+
+	// chains the store data wait of tag onto producer
+	void wait_value(uint32_t tag, uint32_t producer) {
+		entries[tag - 1].next_waiter = waiting[producer];
+		waiting[producer] = tag;
+	}
+	// the chain of stores waiting on producer, linked by next_waiter
+	uint32_t take_waiters(uint32_t producer) {
+		uint32_t first = waiting[producer];
+		waiting[producer] = 0;
+		return first;
+	}
+
+	ROB_ENTRY& operator[](uint32_t tag) { return entries[tag - 1]; }
+	ROB_ENTRY& front() { return entries[head]; }
+	ROB_ENTRY& back() { return entries[(head + count - 1) % entries.size()]; }
+	uint32_t front_tag() const { return head + 1; }
+	uint32_t back_tag() const { return (head + count - 1) % entries.size() + 1; }
+
+	// age order: position 0 is the oldest entry
+	uint32_t tag_at(uint32_t position) const { return (head + position) % entries.size() + 1; }
+	uint32_t position_of(uint32_t tag) const {
+		return (tag - 1 + entries.size() - head) % entries.size();
+	}
+};
+
+// an older store that writes some of the bytes of a load
+struct StoreMatch {
+	unsigned long long seq;
+	uint32_t rob;
+	uint32_t addr;
+	uint32_t size;
+};
+
+// Age-ordered queue of the in-flight stores and AMOs, named by a sequence
+// number that grows with every push. Once its address is known a store is
+// linked into the hash chains of the words it writes, youngest first, so a
+// load only visits the older stores that touch its words. Unknown addresses
+// are tracked in a bitmask per slot.
+class StoreQueue {
+	struct Entry {
+		uint32_t rob{ 0 };
+		uint32_t addr{ 0 };
+		uint32_t size{ 0 };
+		// the words written, the second one if the store is misaligned
+		uint32_t words{ 0 };
+		uint32_t word[2];
+		// seq + 1 of the next older store in each chain, 0 at the end
+		unsigned long long next[2];
+	};
+	std::vector<Entry> entries;
+	unsigned long long head{ 0 };
+	unsigned long long tail{ 0 };
+	// seq + 1 of the youngest store per word hash
+	std::vector<unsigned long long> buckets;
+	std::vector<uint64_t> unresolved;
+
+	Entry& at(unsigned long long seq) { return entries[seq % entries.size()]; }
+	uint32_t bucket_of(uint32_t word) const { return word & (buckets.size() - 1); }
+	void set_unresolved(unsigned long long seq, bool on) {
+		uint64_t bit = uint64_t(1) << (seq % entries.size() % 64);
+		uint64_t& w = unresolved[seq % entries.size() / 64];
+		w = on ? w | bit : w & ~bit;
+	}
+
+public:
+	StoreQueue(uint32_t capacity);
+
+	bool full() const { return tail - head == entries.size(); }
+	// sequence of the next store pushed
+	unsigned long long end() const { return tail; }
 
-	ROB_ENTRY(Instruction& insn) : insn(insn) {};
+	unsigned long long push(uint32_t rob);
+	void pop_front() { ++head; }
+	void resolve(unsigned long long seq, uint32_t addr, uint32_t size);
+	// drops the stores from seq keep on
+	void truncate(unsigned long long keep);
+	void clear();
+
+	// true if a store in [from, to) has no address yet
+	bool unresolved_in(unsigned long long from, unsigned long long to) const;
+	// the resolved stores older than end that overlap [addr, addr + size),
+	// youngest first
+	void older(uint32_t addr, uint32_t size, unsigned long long end, std::vector<StoreMatch>& out);
+	unsigned long long front() const { return head; }
+};
+
+struct SchedulerConfig {
+	uint32_t alu_entries{ ALU_RS_SIZE };
+	uint32_t muldiv_entries{ MULDIV_RS_SIZE };
+	uint32_t addr_entries{ ADDR_RS_SIZE };
+	uint32_t load_entries{ LOAD_BUFFER_SIZE };
+	uint32_t store_entries{ STORE_QUEUE_SIZE };
+	uint32_t fp_entries{ FP_RS_SIZE };
+	// entries each station may start per cycle
+	uint32_t alu_units{ ALU_UNITS };
+	uint32_t muldiv_units{ MULDIV_UNITS };
+	uint32_t addr_units{ ADDR_UNITS };
+	// loads started per cycle
+	uint32_t mem_ports{ MEM_PORTS };
+	uint32_t fp_units{ FP_UNITS };
+};
+
+// Fixed-size reservation station of at most 64 slots. A slot waiting on an
+// operand is recorded in a per-tag bitmask, so a CDB broadcast only touches
+// its consumers. Ready slots start oldest first, at most width per cycle,
+// and keep their slot until they complete.
+class ReservationStation {
+	std::vector<RS_ENTRY> slots;
+	std::vector<unsigned long long> age;
+	// per ROB tag, the slots waiting on it
+	std::vector<uint64_t> waiters;
+	uint64_t all{ 0 };
+	uint64_t busy{ 0 };
+	// operands available
+	uint64_t ready{ 0 };
+	uint64_t started{ 0 };
+	unsigned long long next_age{ 0 };
+	uint32_t width{ 1 };
+	// entries promised to instructions not inserted yet
+	uint32_t reserved{ 0 };
+
+public:
+	ReservationStation(uint32_t entries, uint32_t width, uint32_t tags)
+		: slots(entries), age(entries), waiters(tags + 1), width(width) {
+		all = entries >= 64 ? ~uint64_t(0) : (uint64_t(1) << entries) - 1;
+	}
+
+	bool empty() const { return busy == 0; }
+	bool full() const { return __builtin_popcountll(busy) + reserved >= slots.size(); }
+	uint64_t busy_slots() const { return busy; }
+	uint64_t started_slots() const { return started; }
+	RS_ENTRY& operator[](uint32_t slot) { return slots[slot]; }
+
+	void insert(const RS_ENTRY& rs);
+	void reserve() { ++reserved; }
+	void unreserve() { --reserved; }
+	// inserts into a reserved entry
+	void claim(const RS_ENTRY& rs) {
+		--reserved;
+		insert(rs);
+	}
+	void wakeup(uint32_t tag, int32_t value);
+	// the slots of mask, oldest first
+	uint32_t by_age(uint64_t mask, uint32_t* out) const;
+	// up to width, and at most limit, ready slots that have not started,
+	// oldest first
+	uint32_t select(uint32_t* out, uint32_t limit) const;
+	uint32_t units() const { return width; }
+	void start(uint32_t slot) { started |= uint64_t(1) << slot; }
+	void remove(uint32_t slot) {
+		uint64_t bit = uint64_t(1) << slot;
+		busy &= ~bit;
+		ready &= ~bit;
+		started &= ~bit;
+	}
+	void clear();
 };
 
+// lowest set slot of a mask
+inline uint32_t first_slot(uint64_t mask) { return uint32_t(__builtin_ctzll(mask)); }
+
 struct CDB_ENTRY
 {
 	uint32_t nROB;
@@ -48,34 +282,110 @@ struct CDB_ENTRY
 
 struct REGISTER_STATE {
 	bool busy{ false };
-	uint32_t nROB;
+	uint32_t nROB{ 0 };
 };
 
+struct FrontEndConfig {
+	// instructions moved to the fetch buffer per cycle
+	uint32_t fetch_width{ FETCH_WIDTH };
+	// bytes, power of two
+	uint32_t block_size{ FETCH_BLOCK_SIZE };
+	uint32_t ftq_size{ FTQ_SIZE };
+	uint32_t buffer_size{ INSN_QUEUE_SIZE };
+};
+
+// per-cycle widths of the back end; the front end has its own fetch width
+struct CoreConfig {
+	// instructions renamed into the ROB and reservation stations
+	uint32_t issue_width{ ISSUE_WIDTH };
+	// reservation station entries started on a functional unit
+	uint32_t dispatch_width{ DISPATCH_WIDTH };
+	// results broadcast, the rest wait in their unit
+	uint32_t cdb_width{ CDB_WIDTH };
+	uint32_t commit_width{ COMMIT_WIDTH };
+};
+
+// one predicted fetch block; the decoded instructions carry the
+// predictions made for them
+struct FetchTarget {
+	uint32_t pc{ 0 };
+	std::vector<Instruction> insns;
+	uint32_t consumed{ 0 };
+};
+
+// Out-of-order core behind types 1-3. Type 1 runs it one instruction wide
+// without a branch predictor, types 2 and 3 at the configured widths.
 class Tomasulo {
 	Memory* memory{ nullptr };
 	RegisterFile register_file;
-	REGISTER_STATE register_stat[32];
+	// x0-x31, then f0-f31 from FP_REG_BASE on
+	REGISTER_STATE register_stat[LOGICAL_REGS];
 
+	FrontEndConfig front_end;
+	CoreConfig core;
+	// functional units left to start this cycle
+	uint32_t dispatch_slots{ 0 };
+	std::deque<FetchTarget> FTQ;
 	std::deque<Instruction> instrunction_queue;
-	std::list<ROB_ENTRY> ROB_queue;
-	std::list<RS_ENTRY> ALU_RS;
-	std::list<RS_ENTRY> MULDIV_RS;
-	std::list<RS_ENTRY> ADDR_RS;
-	std::list<RS_ENTRY> LOAD_BUFFER;
+	ReorderBuffer ROB_queue{ ROB_SIZE };
+	ReservationStation ALU_RS{ ALU_RS_SIZE, ALU_UNITS, ROB_SIZE };
+	ReservationStation MULDIV_RS{ MULDIV_RS_SIZE, MULDIV_UNITS, ROB_SIZE };
+	ReservationStation ADDR_RS{ ADDR_RS_SIZE, ADDR_UNITS, ROB_SIZE };
+	ReservationStation LOAD_BUFFER{ LOAD_BUFFER_SIZE, MEM_PORTS, ROB_SIZE };
+	// FADD/FSUB, FMUL and FDIV, pipelined
+	ReservationStation FP_RS{ FP_RS_SIZE, FP_UNITS, ROB_SIZE };
+	StoreQueue SQ{ STORE_QUEUE_SIZE };
+	std::vector<StoreMatch> store_matches;
+    
+    // nullptr predicts every branch taken
+    BranchPredictor* predictor{ nullptr };
+    // nullptr waits for the JALR operand at fetch
+    TargetPredictor* targets{ nullptr };
+    uint32_t redirect_stall{ 0 };
+
+    unsigned long long fetch_blocks{ 0 };
+    unsigned long long fetch_block_insns{ 0 };
+    unsigned long long ftq_full{ 0 };
+    unsigned long long buffer_full{ 0 };
+    unsigned long long icache_stalls{ 0 };
+    // oldest branch or JALR found mispredicted this cycle
+    uint32_t mispredicted{ 0 };
+    unsigned long long squashes{ 0 };
+    unsigned long long squashed{ 0 };
+    // completed results held back by a full CDB
+    unsigned long long cdb_stalls{ 0 };
 
+	CacheHierarchy* caches{ nullptr };
+	FetchPort fetch_port;
+	// nullptr renames through the ROB and register_stat
+	RenameMap* rename{ nullptr };
+	// nullptr keeps loads behind every store with an unknown address
+	StoreSets* store_sets{ nullptr };
+	// oldest load that read ahead of a conflicting store this cycle
+	uint32_t violated{ 0 };
 private:
+	// rg counts f0-f31 from FP_REG_BASE on, their values are float bits
 	bool get_operand(uint32_t rg, int32_t& value, uint32_t& nROB);
+	// a fetched instruction not renamed yet writes rg, ft is the block
+	// being predicted
+	bool unrenamed_writer(uint32_t rg, const FetchTarget& ft) const;
 
+	Stage_Result predict_fetch_target();
 	Stage_Result fetch_n_decode();
 
 	void fill_RSentry(const Instruction& insn, RS_ENTRY& rs, uint32_t nROB);
+	ReservationStation& station_of(const Instruction& insn);
 	Stage_Result issue();
 
 	Stage_Result execute_alu();
 	Stage_Result execute_muldiv();
+	Stage_Result execute_fp();
 	Stage_Result execute_addr_unit();
 
-	bool find_mem_value_in_ROB(uint32_t start_el, uint32_t addr, bool& valid, int32_t& value);
+	// speculative is set when it went past a store with an unknown address
+	bool find_mem_value_in_SQ(uint32_t start_el, uint32_t addr, bool& valid, int32_t& value, bool& speculative);
+	// younger loads that already read addr behind the store
+	void check_violation(uint32_t store);
 	int32_t amo(Function func, int32_t load_value, int32_t src);
 	int32_t read_memory(Function func, int32_t addr);
 	void write_memory(Function func, int32_t addr, int32_t value);
@@ -83,17 +393,50 @@ private:
 
 	void get_ALU_RS_completion(std::list<CDB_ENTRY>&cdb);
 	void get_MULDIV_RS_completion(std::list<CDB_ENTRY>&cdb);
+	void get_FP_RS_completion(std::list<CDB_ENTRY>&cdb);
 	void get_LOAD_BUFFER_completion(std::list<CDB_ENTRY>&cdb);
 	void broadcast(CDB_ENTRY cdb);
 	Stage_Result write_result();
 
+	void restore_front_end(const Instruction& insn);
+	// drops the ROB entries from position keep on and the front end
+	void discard(uint32_t keep);
+	// drops every instruction younger than tag and refetches from its target
+	void squash_after(uint32_t tag);
+	// drops the load and everything younger and refetches the load
+	void replay(uint32_t tag);
+	void retire_rd(const ROB_ENTRY& b);
 	void ROB_clear();
 	Stage_Result commit(unsigned long long clock);
 public:
-    Tomasulo(Memory* mem, uint32_t entry_point, uint32_t sp) : memory(mem) {
+    Tomasulo(Memory* mem, CacheHierarchy* caches, uint32_t entry_point, uint32_t sp)
+		: memory(mem), caches(caches) {
 		register_file.pc = entry_point;
 		register_file.gpr[2] = sp;
 	}
 
+    Tomasulo(Memory* mem, CacheHierarchy* caches, uint32_t entry_point, uint32_t sp, BranchPredictor* predictor, TargetPredictor* targets = nullptr)
+		: memory(mem), predictor(predictor), targets(targets), caches(caches) {
+		register_file.pc = entry_point;
+		register_file.gpr[2] = sp;
+	}
+
+    Tomasulo(Memory* mem, CacheHierarchy* caches, const RegisterFile& rf, BranchPredictor* predictor = nullptr
+		, TargetPredictor* targets = nullptr, const FrontEndConfig& front_end = FrontEndConfig()
+		, const CoreConfig& core = CoreConfig(), uint32_t rob_size = ROB_SIZE
+		, const SchedulerConfig& sched = SchedulerConfig(), RenameMap* rename = nullptr
+		, StoreSets* store_sets = nullptr)
+		: memory(mem), register_file(rf), front_end(front_end), core(core), ROB_queue(rob_size)
+		, ALU_RS(sched.alu_entries, sched.alu_units, rob_size)
+		, MULDIV_RS(sched.muldiv_entries, sched.muldiv_units, rob_size)
+		, ADDR_RS(sched.addr_entries, sched.addr_units, rob_size)
+		, LOAD_BUFFER(sched.load_entries, sched.mem_ports, rob_size)
+		, FP_RS(sched.fp_entries, sched.fp_units, rob_size), SQ(sched.store_entries)
+		, predictor(predictor), targets(targets), caches(caches), rename(rename), store_sets(store_sets) {
+		if (rename)
+			rename->reset(register_file);
+	}
+
 	void run();
+	void report(std::ostream& os) const;
 };